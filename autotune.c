@@ -0,0 +1,284 @@
+/*
+    Copyright (C) 2019  Jacek Danecki <jacek.m.danecki@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "autotune.h"
+#include "fractal_ocl.h"
+#include "parameters.h"
+#include "timer.h"
+
+extern int quiet;
+extern int draw_frames;
+extern void select_fractal(int f);
+
+char* tuning_options[] = {"-w -cl-mad-enable", "-w -cl-mad-enable -cl-fast-relaxed-math", "-w", NULL};
+
+// {0, 0} - local work size selected by driver
+size_t local_sizes[][2] = {{0, 0}, {8, 4}, {8, 8}, {16, 4}, {16, 8}, {16, 16}, {32, 2}, {32, 4}, {32, 8}, {64, 1}, {64, 2}, {128, 1}, {256, 1}};
+#define NR_LOCAL_SIZES (sizeof(local_sizes) / sizeof(local_sizes[0]))
+
+#define NOT_MEASURED ((unsigned long)-1)
+
+struct tuning_result
+{
+    char* options;
+    size_t lws[NR_FRACTALS][2];
+    unsigned long time[NR_FRACTALS];
+    unsigned long total;
+};
+
+struct render_ctx tune_ctx; // kernels are measured on full frame, nothing is read back
+
+unsigned long measure_kernel(struct ocl_device* dev)
+{
+    int r;
+    unsigned long best = NOT_MEASURED;
+
+    if (execute_fractal(dev, &tune_ctx)) return NOT_MEASURED; // warm up
+    for (r = 0; r < TUNE_REPEATS; r++)
+    {
+        if (execute_fractal(dev, &tune_ctx)) return NOT_MEASURED;
+        if (dev->execution < best) best = dev->execution;
+    }
+    return best;
+}
+
+int valid_local_size(struct ocl_device* dev, enum fractals f, size_t* lws)
+{
+    size_t wgs, multiple;
+
+    if (!lws[0]) return 1;
+    if (gws_x % lws[0] || gws_y % lws[1]) return 0;
+
+    if (clGetKernelWorkGroupInfo(dev->kernels[f], dev->device_id, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &wgs, NULL) != CL_SUCCESS) return 0;
+    if (lws[0] * lws[1] > wgs) return 0;
+
+    if (clGetKernelWorkGroupInfo(dev->kernels[f], dev->device_id, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(size_t), &multiple, NULL) ==
+        CL_SUCCESS)
+    {
+        if (multiple && (lws[0] * lws[1]) % multiple) return 0;
+    }
+    return 1;
+}
+
+// the best local work size of every kernel on device built with options
+int tune_local_sizes(struct ocl_device* dev, char* options, struct tuning_result* res)
+{
+    int f, l;
+
+    res->options = options;
+    res->total = 0;
+    for (f = 0; f < NR_FRACTALS; f++)
+    {
+        res->lws[f][0] = 0;
+        res->lws[f][1] = 0;
+        res->time[f] = 0;
+        if (f == DRAGON) continue; // only one work item is used
+
+        select_fractal(f);
+        snapshot_view(&tune_ctx.view);
+        if (prepare_pixels(dev, tune_ctx.view.width, tune_ctx.view.height)) return 1;
+        res->time[f] = NOT_MEASURED;
+        for (l = 0; l < NR_LOCAL_SIZES; l++)
+        {
+            unsigned long t;
+
+            if (!valid_local_size(dev, f, local_sizes[l])) continue;
+            dev->lws[f][0] = local_sizes[l][0];
+            dev->lws[f][1] = local_sizes[l][1];
+            t = measure_kernel(dev);
+            if (!quiet && t != NOT_MEASURED) printf("%s: %s lws=%lux%lu %lu [us]\n", options, fractals[f].name, local_sizes[l][0], local_sizes[l][1], t);
+            if (t < res->time[f])
+            {
+                res->time[f] = t;
+                res->lws[f][0] = local_sizes[l][0];
+                res->lws[f][1] = local_sizes[l][1];
+            }
+        }
+        if (res->time[f] == NOT_MEASURED) return 1;
+        res->total += res->time[f];
+    }
+    return 0;
+}
+
+// program shared by n devices of platform is built with options and kernels are measured on every device
+int tune_options(struct ocl_device* devs, int n, char* options, struct tuning_result* res)
+{
+    int d;
+
+    for (d = 0; d < n; d++) release_kernels(&devs[d]);
+    if (create_kernels(devs, n, options))
+    {
+        printf("%s: can't build kernels with %s\n", devs->name, options);
+        return 1;
+    }
+    for (d = 0; d < n; d++)
+        if (tune_local_sizes(&devs[d], options, &res[d])) return 1;
+    return 0;
+}
+
+/* devices of platform share one program, so build options are selected by total time of all of them,
+   local work sizes are selected for every device */
+int tune_platform(struct ocl_device* devs, int n, struct tuning_result* best)
+{
+    struct tuning_result res[n];
+    unsigned long total, best_total = NOT_MEASURED;
+    char options[sizeof(devs->options)];
+    int o, d;
+
+    snprintf(options, sizeof(options), "%s", platform_options(devs - ocl_devices, n));
+
+    for (o = 0; tuning_options[o]; o++)
+    {
+        if (tune_options(devs, n, tuning_options[o], res)) continue;
+        for (total = 0, d = 0; d < n; d++) total += res[d].total;
+        printf("%s: %-45s total %lu [us]\n", devs->name, tuning_options[o], total);
+        if (total < best_total)
+        {
+            best_total = total;
+            memcpy(best, res, sizeof(res));
+        }
+    }
+    if (best_total == NOT_MEASURED)
+    {
+        // devices keep kernels built with options used before tuning
+        for (d = 0; d < n; d++) release_kernels(&devs[d]);
+        create_kernels(devs, n, options);
+        return 1;
+    }
+
+    for (d = 0; d < n; d++)
+    {
+        memcpy(devs[d].lws, best[d].lws, sizeof(devs[d].lws));
+        snprintf(devs[d].options, sizeof(devs[d].options), "%s", best[d].options);
+        release_kernels(&devs[d]);
+    }
+    return create_kernels(devs, n, devs->options);
+}
+
+int same_device(struct ocl_device* d1, struct ocl_device* d2) { return !strcmp(d1->name, d2->name) && !strcmp(d1->driver_version, d2->driver_version); }
+
+int save_tuning(struct tuning_result* results, int* tuned)
+{
+    char name[512], tmp_name[520];
+    char line[1024], entry[1024];
+    FILE *f, *old;
+    int d, p, i;
+
+    tuning_file_name(name, sizeof(name));
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", name);
+    f = fopen(tmp_name, "w");
+    if (!f)
+    {
+        printf("can't create %s: %s\n", tmp_name, strerror(errno));
+        return 1;
+    }
+    fprintf(f, "# FractalCL tuning database\n");
+    fprintf(f, "# device name|driver version|kernel|local size x|local size y|build options\n");
+
+    // keep entries of devices which weren't tuned now
+    old = fopen(name, "r");
+    if (old)
+    {
+        while (fgets(line, sizeof(line), old))
+        {
+            int keep = 1;
+
+            if (line[0] == '#') continue;
+            for (d = 0; d < nr_devices && keep; d++)
+            {
+                if (!tuned[d]) continue;
+                snprintf(entry, sizeof(entry), "%s|%s|", ocl_devices[d].name, ocl_devices[d].driver_version);
+                if (!strncmp(line, entry, strlen(entry))) keep = 0;
+            }
+            if (keep) fputs(line, f);
+        }
+        fclose(old);
+    }
+
+    for (d = 0; d < nr_devices; d++)
+    {
+        if (!tuned[d]) continue;
+        // the same device and driver is saved once
+        for (p = 0; p < d; p++)
+            if (tuned[p] && same_device(&ocl_devices[d], &ocl_devices[p])) break;
+        if (p < d) continue;
+        for (i = 0; i < NR_FRACTALS; i++)
+        {
+            if (i == DRAGON) continue;
+            fprintf(f, "%s|%s|%s|%lu|%lu|%s\n", ocl_devices[d].name, ocl_devices[d].driver_version, fractals[i].name, results[d].lws[i][0],
+                    results[d].lws[i][1], results[d].options);
+        }
+    }
+    fclose(f);
+
+    if (rename(tmp_name, name))
+    {
+        printf("can't rename %s: %s\n", tmp_name, strerror(errno));
+        return 1;
+    }
+    printf("tuning results saved in %s\n", name);
+    return 0;
+}
+
+int autotune()
+{
+    int d, n, i, err = 0;
+    int old_draw_frames = draw_frames;
+    int old_multi_device = multi_device;
+    enum fractals old_fractal = fractal;
+    struct tuning_result* results;
+    int* tuned;
+
+    if (__atomic_load_n(&ocl_state, __ATOMIC_ACQUIRE) != OCL_READY) return 1;
+
+    results = calloc(nr_devices, sizeof(struct tuning_result));
+    tuned = calloc(nr_devices, sizeof(int));
+    draw_frames = 16;
+    multi_device = 0;
+
+    for (d = 0; d < nr_devices; d += n)
+    {
+        n = platform_devices(d);
+        for (i = d; i < d + n; i++) printf("tuning %s (driver %s)\n", ocl_devices[i].name, ocl_devices[i].driver_version);
+        if (tune_platform(&ocl_devices[d], n, &results[d]))
+        {
+            printf("%s: tuning failed\n", ocl_devices[d].name);
+            err = 1;
+            continue;
+        }
+        for (i = d; i < d + n; i++) tuned[i] = 1;
+        printf("%s: best options: %s\n", ocl_devices[d].name, results[d].options);
+    }
+    for (d = 0; d < nr_devices; d++)
+    {
+        if (!tuned[d]) continue;
+        printf("%s:\n", ocl_devices[d].name);
+        for (i = 0; i < NR_FRACTALS; i++)
+        {
+            if (i == DRAGON) continue;
+            printf("    %-20s lws=%lux%lu %lu [us]\n", fractals[i].name, results[d].lws[i][0], results[d].lws[i][1], results[d].time[i]);
+        }
+    }
+    err |= save_tuning(results, tuned);
+
+    select_fractal(old_fractal);
+    draw_frames = old_draw_frames;
+    multi_device = old_multi_device;
+    free(results);
+    free(tuned);
+    return err;
+}
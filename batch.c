@@ -0,0 +1,598 @@
+/*
+    Copyright (C) 2018-2019  Jacek Danecki <jacek.m.danecki@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* FractalCL-batch renders images without window, SDL and fonts, images of any size are rendered
+   in tiles and streamed to file band by band, memory used doesn't depend on height of image */
+
+#include "image.h"
+#include "iterfile.h"
+#include "libfractalcl.h"
+#include "timer.h"
+#include "window.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#define MAX_JOB_ARGS 64
+#define MAX_WORKERS 17 // CPU and OpenCL devices
+#define NR_BANDS 2     // band written to file while next one is rendered
+#define TILE_COPIES 3  // frames of tile kept by every worker
+
+struct batch_job
+{
+    int device;          // OpenCL device or FCL_DEVICE_CPU
+    int fractal;
+    double cx, cy;       // centre of image
+    double w;            // width of image on complex plane
+    int set_c;           // julia constant given
+    double c_x, c_y;
+    unsigned int max_iter; // 0 - default of fractal
+    int pal;
+    int postprocess;
+    int equalize;        // colors spread by histogram of whole image, image is rendered in one tile
+    int width, height;   // resolution of image
+    int all_backends;    // render tiles on CPU and all OpenCL devices
+    int tile_w, tile_h;  // maximum size of tile
+    int budget;          // [MB] memory for bands and tiles
+    char output[PATH_MAX];
+};
+
+struct tiled_render;
+
+// every backend renders tiles in own context
+struct tile_worker
+{
+    pthread_t tid;
+    int device;
+    struct fcl_context* c;
+    struct tiled_render* r;
+    int tiles;
+    unsigned long render_time;
+};
+
+struct tiled_render
+{
+    struct batch_job* job;
+    struct fcl_view view;           // view of whole image, tiles get own bounds
+    int tiles_x, tiles_y;           // tiles_y is number of bands
+    int tile_w, tile_h;
+    size_t band_pitch;              // bytes of row of band, tiles_x * tile_w pixels
+    char* bands[NR_BANDS];          // band n is rendered in buffer n % NR_BANDS
+    pthread_mutex_t lock;
+    pthread_cond_t band_free;       // band was written to file, its buffer can be reused
+    pthread_cond_t band_done;       // all tiles of band were rendered or rendering failed
+    int next_tile;                  // first tile not taken yet
+    int band_tiles[NR_BANDS];       // rendered tiles of band in buffer
+    int written_bands;
+    int failed;
+    int iterations;                 // bands have numbers of iterations for iteration file
+};
+
+int batch_quiet;
+struct batch_job* jobs;
+int nr_jobs;
+
+void help()
+{
+    puts("FractalCL-batch [options] - render images without window");
+    puts("-dn       - render on n OpenCL device (default CPU)");
+    puts("-fn       - select n fractal type (0 - julia, ..., 7 - tricorn)");
+    puts("-x re     - real part of centre of image");
+    puts("-y im     - imaginary part of centre of image");
+    puts("-w width  - width of image on complex plane (default 3.0)");
+    puts("-C re,im  - constant of julia sets");
+    puts("-i n      - maximum number of iterations");
+    puts("-p n      - palette (0 - hsv, 1 - rgb, 2 - cosine)");
+    puts("-P        - postprocess colors, derived from number of iterations instead of palette");
+    puts("-E        - spread colors of palette by histogram of iterations of image");
+    puts("-s WxH    - resolution of image");
+    puts("-a        - render tiles on CPU and all OpenCL devices");
+    puts("-t WxH    - maximum size of tile (default 1024x1024)");
+    puts("-M n      - memory budget in MB for bands of image and tiles (default 512)");
+    puts("-o file   - output file, .png, .ppm or .fci (numbers of iterations)");
+    puts("-j file   - job file, every line has options of one image, command line options are defaults");
+    puts("-q        - quiet mode - disable logs");
+    puts("-h        - show help");
+}
+
+// options of one job, from command line or from line of job file
+int parse_job(int argc, char* argv[], struct batch_job* job, const char** job_file)
+{
+    int opt;
+
+    optind = 1;
+    while ((opt = getopt(argc, argv, "d:f:x:y:w:C:i:p:PEs:at:M:o:j:qh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            job->device = strtol(optarg, NULL, 0);
+            break;
+        case 'f':
+            job->fractal = strtol(optarg, NULL, 0);
+            if (job->fractal < 0 || job->fractal > FCL_TRICORN)
+            {
+                printf("wrong fractal: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'x':
+            job->cx = strtod(optarg, NULL);
+            break;
+        case 'y':
+            job->cy = strtod(optarg, NULL);
+            break;
+        case 'w':
+            job->w = strtod(optarg, NULL);
+            if (job->w <= 0)
+            {
+                printf("wrong width: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'C':
+            if (sscanf(optarg, "%lf,%lf", &job->c_x, &job->c_y) != 2)
+            {
+                printf("wrong constant: %s\n", optarg);
+                return 1;
+            }
+            job->set_c = 1;
+            break;
+        case 'i':
+            job->max_iter = strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            job->pal = strtol(optarg, NULL, 0);
+            break;
+        case 'P':
+            job->postprocess = 1;
+            break;
+        case 'E':
+            job->equalize = 1;
+            break;
+        case 's':
+            if (sscanf(optarg, "%dx%d", &job->width, &job->height) != 2 || job->width <= 0 || job->height <= 0)
+            {
+                printf("wrong resolution: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'a':
+            job->all_backends = 1;
+            break;
+        case 't':
+            if (sscanf(optarg, "%dx%d", &job->tile_w, &job->tile_h) != 2 || job->tile_w < 16 || job->tile_h < 16)
+            {
+                printf("wrong size of tile: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'M':
+            job->budget = strtol(optarg, NULL, 0);
+            if (job->budget <= 0)
+            {
+                printf("wrong memory budget: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'o':
+            snprintf(job->output, sizeof(job->output), "%s", optarg);
+            break;
+        case 'j':
+            if (!job_file)
+            {
+                puts("job file can't be given in job file");
+                return 1;
+            }
+            *job_file = optarg;
+            break;
+        case 'q':
+            batch_quiet = 1;
+            break;
+        case 'h':
+            help();
+            exit(0);
+        default:
+            return 1;
+        }
+    }
+    if (optind < argc)
+    {
+        printf("unknown argument: %s\n", argv[optind]);
+        return 1;
+    }
+    return 0;
+}
+
+int add_job(struct batch_job* job)
+{
+    struct batch_job* j;
+
+    if (!job->output[0])
+    {
+        printf("output file of job %d not given\n", nr_jobs);
+        return 1;
+    }
+    j = realloc(jobs, (nr_jobs + 1) * sizeof(*jobs));
+    if (!j) return 1;
+    jobs = j;
+    jobs[nr_jobs++] = *job;
+    return 0;
+}
+
+// every line is job with options like command line, empty lines and lines started from # are skipped
+int read_job_file(const char* path, struct batch_job* defaults)
+{
+    char line[4096];
+    char* argv[MAX_JOB_ARGS];
+    int argc, nr_line = 0;
+    FILE* f = fopen(path, "r");
+
+    if (!f)
+    {
+        printf("can't open job file %s\n", path);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), f))
+    {
+        struct batch_job job = *defaults;
+        char* tok;
+
+        nr_line++;
+        argv[0] = "job";
+        argc = 1;
+        for (tok = strtok(line, " \t\r\n"); tok && argc < MAX_JOB_ARGS; tok = strtok(NULL, " \t\r\n")) argv[argc++] = tok;
+        if (argc == 1 || argv[1][0] == '#') continue;
+        job.output[0] = 0;
+        if (parse_job(argc, argv, &job, NULL) || add_job(&job))
+        {
+            printf("wrong job in line %d of %s\n", nr_line, path);
+            fclose(f);
+            return 1;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+// tile (tx, ty) covers tile_w x tile_h pixels from (tx * tile_w, ty * tile_h) of image
+void tile_view(struct batch_job* job, struct fcl_view* v, int tile_w, int tile_h, int tx, int ty)
+{
+    double step = job->w / job->width;
+    double left = job->cx - job->w / 2;
+    double top = job->cy + step * job->height / 2;
+
+    v->x1 = left + step * tx * tile_w;
+    v->x2 = v->x1 + step * tile_w;
+    v->y1 = top - step * ty * tile_h;
+    v->y2 = v->y1 - step * tile_h;
+}
+
+/* size of tiles for memory budget, bands of tile_h rows are kept in NR_BANDS buffers and every
+   worker needs about TILE_COPIES frames of tile (context frame, staging memory and host frame of device) */
+int tile_size(struct batch_job* job, int workers, struct tiled_render* r)
+{
+    size_t budget = (size_t)job->budget << 20;
+    size_t row_bytes;
+    int max_h;
+
+    r->tiles_x = (job->width + job->tile_w - 1) / job->tile_w;
+    // tiles of similar size, multiples of 4 like frames so views of tiles don't have to be extended
+    r->tile_w = ((job->width + r->tiles_x - 1) / r->tiles_x + 3) & ~3;
+    r->tiles_x = (job->width + r->tile_w - 1) / r->tile_w;
+    r->band_pitch = (size_t)r->tiles_x * r->tile_w * 4;
+
+    row_bytes = NR_BANDS * r->band_pitch + (size_t)workers * TILE_COPIES * r->tile_w * 4;
+    max_h = (budget / row_bytes) & ~3;
+    if (max_h > job->tile_h) max_h = job->tile_h;
+    if (max_h > job->height) max_h = job->height;
+    if (max_h < 1 || (max_h < 4 && max_h < job->height))
+    {
+        printf("memory budget %d MB is too small for image width %d\n", job->budget, job->width);
+        return 1;
+    }
+    r->tiles_y = (job->height + max_h - 1) / max_h;
+    r->tile_h = ((job->height + r->tiles_y - 1) / r->tiles_y + 3) & ~3;
+    r->tiles_y = (job->height + r->tile_h - 1) / r->tile_h;
+    return 0;
+}
+
+// render tile t of image, tiles are numbered by rows of bands
+int render_tile(struct tiled_render* r, struct tile_worker* w, int t)
+{
+    int band = t / r->tiles_x, tx = t % r->tiles_x;
+    char* dst = r->bands[band % NR_BANDS] + (size_t)tx * r->tile_w * 4;
+    struct fcl_view v = r->view;
+
+    if (r->job->fractal != FCL_DRAGON) tile_view(r->job, &v, r->tile_w, r->tile_h, tx, band);
+    if (fcl_set_view(w->c, &v)) return 1;
+    if (r->iterations ? fcl_render_iterations(w->c, (unsigned int*)dst, r->band_pitch) : fcl_render(w->c, dst, r->band_pitch)) return 1;
+    w->render_time += fcl_render_time(w->c);
+    w->tiles++;
+    return 0;
+}
+
+/* workers take tiles in order, tiles of band can be taken when its buffer was written to file,
+   so at most NR_BANDS bands are rendered or written at the same time */
+void* tile_worker(void* p)
+{
+    struct tile_worker* w = p;
+    struct tiled_render* r = w->r;
+    int t, err;
+
+    pthread_mutex_lock(&r->lock);
+    while (!r->failed && r->next_tile < r->tiles_x * r->tiles_y)
+    {
+        t = r->next_tile;
+        if (t / r->tiles_x >= r->written_bands + NR_BANDS)
+        {
+            pthread_cond_wait(&r->band_free, &r->lock);
+            continue;
+        }
+        r->next_tile++;
+        pthread_mutex_unlock(&r->lock);
+
+        err = render_tile(r, w, t);
+
+        pthread_mutex_lock(&r->lock);
+        if (err)
+        {
+            printf("can't render tile %d of %s\n", t, r->job->output);
+            r->failed = 1;
+        }
+        if (++r->band_tiles[(t / r->tiles_x) % NR_BANDS] == r->tiles_x || err) pthread_cond_signal(&r->band_done);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return NULL;
+}
+
+// iteration file is written instead of image for .fci extension
+int iteration_output(const char* path)
+{
+    const char* ext = strrchr(path, '.');
+
+    return ext && !strcasecmp(ext, ".fci");
+}
+
+// view of whole image, precision is double only if every worker calculates in double
+void iter_header(struct tiled_render* r, struct tile_worker* workers, int nr_workers, struct fci_header* h)
+{
+    struct batch_job* job = r->job;
+    double step = job->w / job->width;
+    int i;
+
+    memset(h, 0, sizeof(*h));
+    h->width = job->width;
+    h->height = job->height;
+    h->fractal = job->fractal;
+    h->x1 = job->cx - job->w / 2;
+    h->x2 = h->x1 + job->w;
+    h->y1 = job->cy + step * job->height / 2;
+    h->y2 = h->y1 - step * job->height;
+    h->c_x = r->view.c_x;
+    h->c_y = r->view.c_y;
+    h->er = r->view.er;
+    h->max_iter = r->view.max_iter;
+    h->mod1 = r->view.mod1;
+    h->flags = FCI_FP64;
+    for (i = 0; i < nr_workers; i++)
+        if (!fcl_fp64(workers[i].c)) h->flags &= ~FCI_FP64;
+}
+
+void show_progress(struct tiled_render* r, int band, unsigned long tp1)
+{
+    double elapsed = (get_time_usec() - tp1) / 1000000.0;
+    double pixels = (double)r->job->width * (band == r->tiles_y - 1 ? r->job->height : (band + 1) * r->tile_h);
+    double done = pixels / ((double)r->job->width * r->job->height);
+
+    printf("\r%s: band %d/%d, %.1f%%, %.1f Mpx/s, eta %.0f s   ", r->job->output, band + 1, r->tiles_y, 100.0 * done, pixels / elapsed / 1000000.0,
+           elapsed / done - elapsed);
+    fflush(stdout);
+}
+
+/* image is rendered in bands of tiles by one worker for every used backend, finished bands
+   are streamed to file, so memory doesn't depend on height and stays within memory budget */
+int render_job(struct batch_job* job)
+{
+    struct tiled_render r;
+    struct tile_worker workers[MAX_WORKERS];
+    struct image_file* img = NULL;
+    struct iter_file* fci = NULL;
+    struct fci_header hdr;
+    unsigned long tp1 = get_time_usec(), render_time = 0;
+    int nr_workers = 0, started = 0, band = 0, rows, i, d;
+
+    memset(&r, 0, sizeof(r));
+    r.job = job;
+    fcl_default_view(job->fractal, &r.view);
+    if (job->max_iter) r.view.max_iter = job->max_iter;
+    if (job->set_c)
+    {
+        r.view.c_x = job->c_x;
+        r.view.c_y = job->c_y;
+    }
+    r.view.pal = job->pal;
+    r.view.postprocess = job->postprocess;
+    r.view.equalize = job->equalize;
+    r.iterations = iteration_output(job->output);
+
+    // CPU and all OpenCL devices or only selected backend
+    memset(workers, 0, sizeof(workers));
+    if (job->all_backends || job->device == FCL_DEVICE_CPU) workers[nr_workers++].device = FCL_DEVICE_CPU;
+    for (d = 0; d < fcl_devices() && nr_workers < MAX_WORKERS; d++)
+        if (job->all_backends || job->device == d) workers[nr_workers++].device = d;
+    if (!nr_workers)
+    {
+        printf("device %d not found\n", job->device);
+        return 1;
+    }
+    // every tile would be equalized by own histogram
+    if (job->equalize && !r.iterations)
+    {
+        job->tile_w = job->width;
+        job->tile_h = job->height;
+    }
+    if (tile_size(job, nr_workers, &r)) return 1;
+    if (job->fractal == FCL_DRAGON && r.tiles_x * r.tiles_y > 1)
+    {
+        puts("dragon can't be rendered in tiles, increase tile size or memory budget");
+        return 1;
+    }
+    if (job->equalize && !r.iterations && r.tiles_x * r.tiles_y > 1)
+    {
+        puts("equalized image can't be rendered in tiles, increase memory budget");
+        return 1;
+    }
+    if (job->fractal == FCL_DRAGON && r.iterations)
+    {
+        puts("dragon doesn't have numbers of iterations");
+        return 1;
+    }
+
+    pthread_mutex_init(&r.lock, NULL);
+    pthread_cond_init(&r.band_free, NULL);
+    pthread_cond_init(&r.band_done, NULL);
+    for (i = 0; i < NR_BANDS; i++)
+    {
+        r.bands[i] = malloc(r.band_pitch * r.tile_h);
+        if (!r.bands[i]) goto out;
+    }
+    for (i = 0; i < nr_workers; i++)
+    {
+        workers[i].r = &r;
+        workers[i].c = fcl_create(workers[i].device, r.tile_w, r.tile_h);
+        if (!workers[i].c)
+        {
+            printf("can't render on device %d\n", workers[i].device);
+            goto out;
+        }
+    }
+    if (r.iterations)
+    {
+        iter_header(&r, workers, nr_workers, &hdr);
+        fci = create_iter_file(job->output, &hdr);
+    }
+    else
+        img = create_image(job->output, job->width, job->height);
+    if (!img && !fci) goto out;
+    if (!batch_quiet)
+        printf("%s: %dx%d in %dx%d tiles of %dx%d, %d worker(s), %zu MB of bands\n", job->output, job->width, job->height, r.tiles_x, r.tiles_y, r.tile_w,
+               r.tile_h, nr_workers, NR_BANDS * r.band_pitch * r.tile_h >> 20);
+
+    for (started = 0; started < nr_workers; started++)
+        if (pthread_create(&workers[started].tid, NULL, tile_worker, &workers[started])) break;
+
+    for (band = 0; band < r.tiles_y; band++)
+    {
+        pthread_mutex_lock(&r.lock);
+        while (!r.failed && r.band_tiles[band % NR_BANDS] < r.tiles_x) pthread_cond_wait(&r.band_done, &r.lock);
+        pthread_mutex_unlock(&r.lock);
+        if (r.failed) break;
+
+        rows = band == r.tiles_y - 1 ? job->height - band * r.tile_h : r.tile_h;
+        if (fci ? write_iter_rows(fci, r.bands[band % NR_BANDS], rows, r.band_pitch) : write_image_rows(img, r.bands[band % NR_BANDS], rows, r.band_pitch))
+        {
+            printf("can't write %s\n", job->output);
+            break;
+        }
+        if (!batch_quiet) show_progress(&r, band, tp1);
+
+        pthread_mutex_lock(&r.lock);
+        r.band_tiles[band % NR_BANDS] = 0;
+        r.written_bands++;
+        pthread_cond_broadcast(&r.band_free);
+        pthread_mutex_unlock(&r.lock);
+    }
+    if (!batch_quiet) printf("\n");
+    // workers waiting for free band have to stop
+    if (band < r.tiles_y)
+    {
+        pthread_mutex_lock(&r.lock);
+        r.failed = 1;
+        pthread_cond_broadcast(&r.band_free);
+        pthread_mutex_unlock(&r.lock);
+    }
+    for (i = 0; i < started; i++) pthread_join(workers[i].tid, NULL);
+out:
+    if (((img && close_image(img)) || (fci && close_iter_file(fci))) && !r.failed)
+    {
+        printf("can't write %s\n", job->output);
+        r.failed = 1;
+    }
+    for (i = 0; i < nr_workers; i++)
+    {
+        if (!workers[i].c) continue;
+        render_time += workers[i].render_time;
+        if (!batch_quiet && workers[i].tiles)
+            printf("  %s %d: %d tiles, render %.3f s\n", workers[i].device == FCL_DEVICE_CPU ? "cpu" : "ocl device", workers[i].device, workers[i].tiles,
+                   workers[i].render_time / 1000000.0);
+        fcl_destroy(workers[i].c);
+    }
+    for (i = 0; i < NR_BANDS; i++) free(r.bands[i]);
+    pthread_cond_destroy(&r.band_done);
+    pthread_cond_destroy(&r.band_free);
+    pthread_mutex_destroy(&r.lock);
+    if (!img && !fci) return 1;
+    if (!r.failed && !batch_quiet)
+        printf("%s: %dx%d, render %.3f s, total %.3f s, %.1f Mpx/s\n", job->output, job->width, job->height, render_time / 1000000.0,
+               (get_time_usec() - tp1) / 1000000.0, (double)job->width * job->height / (get_time_usec() - tp1));
+    return r.failed;
+}
+
+int main(int argc, char* argv[])
+{
+    struct batch_job defaults;
+    const char* job_file = NULL;
+    unsigned long tp1 = get_time_usec();
+    int opencl = 0, failed = 0, i;
+
+    memset(&defaults, 0, sizeof(defaults));
+    defaults.device = FCL_DEVICE_CPU;
+    defaults.fractal = FCL_MANDELBROT;
+    defaults.w = 3.0;
+    defaults.width = DEFAULT_WIDTH;
+    defaults.height = DEFAULT_HEIGHT;
+    defaults.tile_w = 1024;
+    defaults.tile_h = 1024;
+    defaults.budget = 512;
+
+    if (parse_job(argc, argv, &defaults, &job_file)) return 1;
+    if (job_file ? read_job_file(job_file, &defaults) : add_job(&defaults)) return 1;
+
+    for (i = 0; i < nr_jobs; i++)
+        if (jobs[i].device != FCL_DEVICE_CPU || jobs[i].all_backends) opencl = 1;
+    if (fcl_init(opencl))
+    {
+        // jobs of selected OpenCL devices fail, other ones are rendered on CPU
+        if (!opencl || fcl_init(0))
+        {
+            puts("can't initialize render library");
+            return 1;
+        }
+        puts("OpenCL can't be used, rendering on CPU");
+    }
+    for (i = 0; i < nr_jobs; i++) failed += render_job(&jobs[i]);
+    fcl_shutdown();
+    free(jobs);
+
+    printf("%d images rendered, %d failed, time %.3f s\n", nr_jobs - failed, failed, (get_time_usec() - tp1) / 1000000.0);
+    return failed != 0;
+}
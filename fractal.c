@@ -22,38 +22,47 @@
 #include "fractal.h"
 #endif
 
-#include "kernels/burning_ship.cl"
-#include "kernels/common.cl"
-#include "kernels/dragon.cl"
-#include "kernels/generalized_celtic.cl"
-#include "kernels/julia.cl"
-#include "kernels/julia3.cl"
-#include "kernels/julia_full.cl"
-#include "kernels/mandelbrot.cl"
-#include "kernels/tricorn.cl"
-
+#include "iterfile.h"
 #include "palette.h"
 #include "parameters.h"
 #include "timer.h"
+#ifdef OPENCL_SUPPORT
+#include "autotune.h"
+#endif
 
 void* cpu_pixels;
-int quiet;
+void* shown_iterations; // iterations of frame shown in window, it's colored again when palette changes
+int recolor;            // palette changed, shown frame has to be colored again
+struct palette_table shown_palette; // palette table of shown frame, used only by UI thread
+int equalize;           // colors spread by histogram of frame
+unsigned int* shown_histogram; // histogram of iterations of shown frame, frame_width + 1 bins
+int shown_histogram_valid;
 int all_devices;
 char status_line[200];
 
 int draw_frames = 16;
 
-#ifdef OPENCL_SUPPORT
-extern pthread_cond_t cond_fin;
-extern pthread_mutex_t lock_fin;
-extern volatile int tasks_finished;
-#endif
-
 int performance_test;
 int show_iterations;
+int preferred_device = -1;
 unsigned long last_avg_result;
 int console_mode;
 
+struct view shown_view;      // frame presented in window
+struct view posted_view;     // last frame posted to render thread
+unsigned long last_present;  // time of last presentation of window
+
+pthread_t render_tid;
+pthread_mutex_t render_lock;
+pthread_cond_t render_cond;
+struct view next_view; // posted by UI thread and not taken by render thread yet
+struct view done_view; // frame calculated by render thread and not presented yet
+volatile unsigned int generation;
+int view_posted;
+int rendering;
+int frame_done;
+int render_finish;
+
 char* fractals_names[NR_FRACTALS] = {"julia z^2", "mandelbrot", "julia full", "dragon", "julia z^3", "burning ship", "generalized celtic", "tricorn"};
 
 enum app_modes
@@ -61,208 +70,130 @@ enum app_modes
     APP_GUI,  // default GUI support
     APP_TEST, // performance test
     APP_DISC, // discovery mode, show devices
+    APP_TUNE, // tune local work size and build options of OpenCL kernels
 };
 
-struct cpu_args
-{
-    int xs, xe, ys, ye;
-};
+int hybrid; // CPU threads and OCL device(s) share tiles of one frame
 
-#ifdef FP_64_SUPPORT
-struct kernel_args64 cpu_kernel_args;
-#else
-struct kernel_args32 cpu_kernel_args;
-#endif
+struct iter_file* stored_data; // iteration file browsed in window, frames showing its points aren't calculated
 
-void prepare_cpu_args()
+/* palette isn't used by kernels, frames are colored with current palette when they are presented,
+   so frames calculated before change of palette don't bring back old colors */
+void apply_palette(struct view* v)
 {
     int c;
 
-    cpu_kernel_args.ofs_lx = ofs_lx;
-    cpu_kernel_args.ofs_rx = ofs_rx;
-    cpu_kernel_args.ofs_ty = ofs_ty;
-    cpu_kernel_args.ofs_by = ofs_by;
-
-    FP_TYPE ofs_lx1 = (ofs_lx + dx) / szx;
-    FP_TYPE ofs_rx1 = (ofs_rx + dx) / szx;
-    FP_TYPE ofs_ty1 = (ofs_ty + dy) / szy;
-    FP_TYPE ofs_by1 = (ofs_by + dy) / szy;
-
-    lx = ofs_lx1;
-    cpu_kernel_args.ofs_lx = ofs_lx1;
-    rx = ofs_rx1;
-    ty = ofs_ty1;
-    cpu_kernel_args.ofs_ty = ofs_ty1;
-    by = ofs_by1;
-
-    cpu_kernel_args.step_x = (ofs_rx1 - ofs_lx1) / WIDTH_FL;
-    cpu_kernel_args.step_y = (ofs_by1 - ofs_ty1) / HEIGHT_FL;
-
-    cpu_kernel_args.rgb = rgb;
-    cpu_kernel_args.mm = mm;
-    cpu_kernel_args.er = er;
-    cpu_kernel_args.max_iter = max_iter;
-    cpu_kernel_args.mod1 = mod1;
-    cpu_kernel_args.pal = pal;
-    cpu_kernel_args.c_x = c_x;
-    cpu_kernel_args.c_y = c_y;
-    cpu_kernel_args.post_process = postprocess;
-
+    v->rgb = rgb;
+    v->mm = mm;
+    v->pal = pal;
+    v->postprocess = postprocess;
+    v->equalize = equalize;
     for (c = 0; c < 3; c++)
     {
-        cpu_kernel_args.c1[c] = c1[c];
-        cpu_kernel_args.c2[c] = c2[c];
-        cpu_kernel_args.c3[c] = c3[c];
-        cpu_kernel_args.c4[c] = c4[c];
-    }
-}
-
-unsigned int calculate_one_pixel(int x, int y)
-{
-    switch (fractal)
-    {
-    case JULIA:
-        return julia(cpu_kernel_args.ofs_x + x * 4, cpu_kernel_args.ofs_y + y * 4, cpu_pixels, colors, cpu_kernel_args);
-
-    case JULIA3:
-        return julia3(cpu_kernel_args.ofs_x + x * 4, cpu_kernel_args.ofs_y + y * 4, cpu_pixels, colors, cpu_kernel_args);
-
-    case JULIA_FULL:
-        return julia_full(x, y, cpu_pixels, colors, cpu_kernel_args);
-
-    case MANDELBROT:
-        return mandelbrot(cpu_kernel_args.ofs_x + x * 4, cpu_kernel_args.ofs_y + y * 4, cpu_pixels, colors, cpu_kernel_args);
-
-    case BURNING_SHIP:
-        return burning_ship(cpu_kernel_args.ofs_x + x * 4, cpu_kernel_args.ofs_y + y * 4, cpu_pixels, colors, cpu_kernel_args);
-
-    case GENERALIZED_CELTIC:
-        return generalized_celtic(cpu_kernel_args.ofs_x + x * 4, cpu_kernel_args.ofs_y + y * 4, cpu_pixels, colors, cpu_kernel_args);
-
-    case TRICORN:
-        return tricorn(cpu_kernel_args.ofs_x + x * 4, cpu_kernel_args.ofs_y + y * 4, cpu_pixels, colors, cpu_kernel_args);
-
-    default:
-        return 0;
-    }
-}
-
-void* execute_fractal_cpu(void* c)
-{
-    int x, y;
-    struct cpu_args* cpu = (struct cpu_args*)c;
-
-    prepare_cpu_args();
-
-    for (y = cpu->ys; y < cpu->ye; y++)
-    {
-        for (x = cpu->xs; x < cpu->xe; x++)
-        {
-            calculate_one_pixel(x, y);
-        }
+        v->c1[c] = c1[c];
+        v->c2[c] = c2[c];
+        v->c3[c] = c3[c];
+        v->c4[c] = c4[c];
     }
-    return NULL;
+    view_kernel_args(v);
 }
 
-void start_cpu()
+void snapshot_view(struct view* v)
 {
-    unsigned long tp1, tp2;
-    int t;
-
-    tp1 = get_time_usec();
-
-    int frame;
-    for (frame = 0; frame < draw_frames; frame++)
-    {
-        cpu_kernel_args.ofs_x++;
-        if (cpu_kernel_args.ofs_x == 4)
-        {
-            cpu_kernel_args.ofs_y++;
-            cpu_kernel_args.ofs_x = 0;
-        }
-        if (cpu_kernel_args.ofs_y == 4)
-        {
-            cpu_kernel_args.ofs_x = 0;
-            cpu_kernel_args.ofs_y = 0;
-        }
-
-        if (fractal == DRAGON)
-        {
-            memset(cpu_pixels, 0, IMAGE_SIZE);
-            prepare_cpu_args();
-            dragon(0, 0, cpu_pixels, colors, cpu_kernel_args);
-        }
-        else
-        {
-            struct cpu_args t_args[16] = {{0, gws_x / 4, 0, gws_y / 4},
-                                          {gws_x / 4, gws_x / 2, 0, gws_y / 4},
-                                          {gws_x / 2, gws_x * 3 / 4, 0, gws_y / 4},
-                                          {gws_x * 3 / 4, gws_x, 0, gws_y / 4},
-
-                                          {0, gws_x / 4, gws_y / 4, gws_y / 2},
-                                          {gws_x / 4, gws_x / 2, gws_y / 4, gws_y / 2},
-                                          {gws_x / 2, gws_x * 3 / 4, gws_y / 4, gws_y / 2},
-                                          {gws_x * 3 / 4, gws_x, gws_y / 4, gws_y / 2},
-
-                                          {0, gws_x / 4, gws_y / 2, gws_y * 3 / 4},
-                                          {gws_x / 4, gws_x / 2, gws_y / 2, gws_y * 3 / 4},
-                                          {gws_x / 2, gws_x * 3 / 4, gws_y / 2, gws_y * 3 / 4},
-                                          {gws_x * 3 / 4, gws_x, gws_y / 2, gws_y * 3 / 4},
-
-                                          {0, gws_x / 4, gws_y * 3 / 4, gws_y},
-                                          {gws_x / 4, gws_x / 2, gws_y * 3 / 4, gws_y},
-                                          {gws_x / 2, gws_x * 3 / 4, gws_y * 3 / 4, gws_y},
-                                          {gws_x * 3 / 4, gws_x, gws_y * 3 / 4, gws_y}};
-
-            pthread_t tid[16];
-            for (t = 0; t < 16; t++)
-            {
-                pthread_create(&tid[t], NULL, execute_fractal_cpu, &t_args[t]);
-            }
-            for (t = 0; t < 16; t++)
-            {
-                pthread_join(tid[t], NULL);
-            }
-        }
-    }
-    tp2 = get_time_usec();
-    cpu_execution = tp2 - tp1;
+    v->ofs_lx = ofs_lx;
+    v->ofs_rx = ofs_rx;
+    v->ofs_ty = ofs_ty;
+    v->ofs_by = ofs_by;
+    v->dx = dx;
+    v->dy = dy;
+    v->szx = szx;
+    v->szy = szy;
+    v->er = er;
+    v->c_x = c_x;
+    v->c_y = c_y;
+    v->max_iter = max_iter;
+    v->mod1 = mod1;
+    v->fractal = fractal;
+    v->width = frame_width;
+    v->height = frame_height;
+    v->gws_x = gws_x;
+    v->gws_y = gws_y;
+    v->draw_frames = draw_frames;
+    v->cur_dev = cur_dev;
+    v->hybrid = hybrid;
+    v->generation = generation;
+    v->stored = 0;
+#ifdef OPENCL_SUPPORT
+    v->device = current_device;
+    v->multi_device = multi_device;
+#else
+    v->device = 0;
+    v->multi_device = 0;
+#endif
+    apply_palette(v);
+    // postprocessed frames calculated by OCL devices are colored there, they are calculated again to leave this mode
+    v->device_color = v->postprocess && !v->equalize && !show_iterations && v->cur_dev && !use_hybrid(v) && v->fractal != DRAGON && v->max_iter < PALETTE_MAX_COLORS;
 }
 
-unsigned long calculate_avg_time(unsigned long* exec_time)
+unsigned long calculate_avg_time(struct view* v, struct render_ctx* ctx, unsigned long* exec_time)
 {
     unsigned long avg;
 #ifdef OPENCL_SUPPORT
-    if (cur_dev)
+    if (v->cur_dev || use_hybrid(v))
     {
-        *exec_time = ocl_devices[current_device].execution;
+        *exec_time = ctx->ocl_execution;
         avg = gpu_iter ? gpu_executions / gpu_iter : 0;
     }
     else
     {
-        *exec_time = cpu_execution;
+        *exec_time = ctx->cpu_execution;
         avg = cpu_iter ? cpu_executions / cpu_iter : 0;
     }
 
 #else
-    *exec_time = cpu_execution;
+    *exec_time = ctx->cpu_execution;
     avg = cpu_iter ? cpu_executions / cpu_iter : 0;
 #endif
     return avg;
 }
 
+#ifdef OPENCL_SUPPORT
+void draw_ocl_state(int row)
+{
+    char buf[64];
+
+    switch (__atomic_load_n(&ocl_state, __ATOMIC_ACQUIRE))
+    {
+    case OCL_INIT:
+        sprintf(buf, " compiling %d/%d", ocl_steps_done, ocl_steps);
+        break;
+    case OCL_READY:
+        sprintf(buf, " ready, %d device(s)", __atomic_load_n(&nr_devices, __ATOMIC_ACQUIRE));
+        break;
+    case OCL_FAILED:
+        sprintf(buf, " not available");
+        break;
+    }
+    draw_string(row, "OCL", buf);
+}
+#endif
+
 void draw_right_panel(int column)
 {
     int row = 0;
     unsigned long exec_time;
     unsigned long avg, r_avg;
 
-    draw_box(WIDTH, 0, RIGTH_PANEL_WIDTH, HEIGHT, 0, 0, 60);
+    draw_box(frame_width, 0, RIGTH_PANEL_WIDTH, frame_height, 0, 0, 60);
 
     draw_string(row++, "===", " Main ====");
     draw_int(row++, "F1-F8 fractal (F9:mod1)", fractal);
 #ifdef OPENCL_SUPPORT
     draw_int(row++, "v device", cur_dev);
+    draw_2long(row++, "b all", multi_device, "o cpu+ocl", hybrid);
+    if (use_hybrid(&shown_view))
+        draw_2long(row++, "Mpx/s cpu", window_ctx.backend_pps[BACKEND_CPU] / 1000000, "ocl", window_ctx.backend_pps[BACKEND_OCL] / 1000000);
+    draw_ocl_state(row++);
 #endif
     draw_double(row++, "lx", lx);
     draw_double(row++, "rx", rx);
@@ -288,6 +219,7 @@ void draw_right_panel(int column)
 
     draw_string(row++, "P ", " Colors ==");
     draw_int(row++, "p pal", pal);
+    draw_int(row++, "3 equalize", equalize);
     draw_hex(row++, "c/C channel", color_channel);
 
     if (pal < 2)
@@ -312,7 +244,7 @@ void draw_right_panel(int column)
     draw_double(row++, "w/s dy", dy);
 
     draw_string(row++, "SPACE", " Benchmarking [us]");
-    avg = calculate_avg_time(&exec_time);
+    avg = calculate_avg_time(&shown_view, &window_ctx, &exec_time);
 
     draw_2long(row++, "exec", exec_time, "avg", avg);
     last_avg_result = avg;
@@ -331,7 +263,7 @@ void draw_right_panel(int column)
 
         if (avg + r_avg)
         {
-            res = (HEIGHT_FL - 60) * avg / (avg + r_avg);
+            res = (frame_height - 60.0f) * avg / (avg + r_avg);
         }
         dst.h = res;
 
@@ -340,85 +272,63 @@ void draw_right_panel(int column)
 
         if (avg + r_avg)
         {
-            res = (HEIGHT_FL - 60) * r_avg / (avg + r_avg);
+            res = (frame_height - 60.0f) * r_avg / (avg + r_avg);
         }
         dst.h = res;
-        if (dst.x + 5 < WIDTH) dst.x += 5;
+        if (dst.x + 5 < frame_width) dst.x += 5;
 
         SDL_SetRenderDrawColor(main_window, 128, 255, 128, 255);
         SDL_RenderFillRect(main_window, &dst);
     }
 }
 
+// bars of histogram of iterations of shown frame, it's counted again only when new frame is shown
 void show_iterations_window()
 {
-    int x, y, max_x, max_p = WIDTH * HEIGHT / 16;
-    unsigned int* iter_map;
-    unsigned int iter;
-
-    unsigned char* pixels;
-    int pitch;
-    SDL_Rect window_rec;
+    int x, y, max_x = shown_view.max_iter > frame_width ? frame_width : shown_view.max_iter;
+    int max_p = frame_width * frame_height;
 
-    window_rec.w = WIDTH;
-    window_rec.h = HEIGHT;
-    window_rec.x = 0;
-    window_rec.y = 0;
-
-    prepare_cpu_args();
-
-    max_x = max_iter > WIDTH ? WIDTH : max_iter;
-    iter_map = calloc(max_x, sizeof(iter));
-
-    for (y = 0; y < HEIGHT / 4; y++)
+    // dragon and frames colored on device don't have iterations on host
+    if (shown_view.fractal == DRAGON || shown_view.device_color) return;
+    if (!shown_histogram_valid)
     {
-        for (x = 0; x < WIDTH / 4; x++)
-        {
-            iter = calculate_one_pixel(x, y);
-            if (iter < max_x)
-            {
-                iter_map[iter]++;
-            }
-        }
+        // numbers of iterations not shown are counted in the last bin
+        if (histogram_rows(shown_iterations, FRAME_PITCH(&shown_view), frame_width, frame_height, shown_histogram, max_x + 1)) return;
+        shown_histogram_valid = 1;
     }
 
-    SDL_LockTexture(texture, NULL, (void**)&pixels, &pitch);
-
+    SDL_SetRenderDrawColor(main_window, 255, 255, 255, 255);
     for (x = 0; x < max_x; x++)
     {
-        int ny;
-        int ly;
-        y = roundf(1.0f * (HEIGHT - 1) * iter_map[x] / max_p);
-        for (ly = 0; ly < y; ly++)
-        {
-            ny = pitch * ly;
-            pixels[ny + x * 4] = 255;
-            pixels[ny + x * 4 + 1] = 255;
-            pixels[ny + x * 4 + 2] = 255;
-            pixels[ny + x * 4 + 3] = 255;
-        }
+        y = roundf(1.0f * (frame_height - 1) * shown_histogram[x] / max_p);
+        if (y) SDL_RenderDrawLine(main_window, x, 0, x, y - 1);
     }
-    SDL_UnlockTexture(texture);
-    SDL_RenderCopy(main_window, texture, NULL, &window_rec);
-    free(iter_map);
 }
 
-void prepare_frames()
+// statistics shown in window and performance test
+void update_counters(struct render_ctx* ctx)
 {
 #ifdef OPENCL_SUPPORT
-    if (cur_dev)
+    if (ctx->view.cur_dev || use_hybrid(&ctx->view))
     {
-        start_ocl();
-        gpu_executions += ocl_devices[current_device].execution;
+        gpu_executions += ctx->ocl_execution;
         gpu_iter++;
+        return;
     }
-    else
 #endif
-    {
-        start_cpu();
-        cpu_executions += cpu_execution;
-        cpu_iter++;
-    }
+    cpu_executions += ctx->cpu_execution;
+    cpu_iter++;
+}
+
+// calculate frame for current parameters without render thread
+void prepare_frames()
+{
+    snapshot_view(&window_ctx.view);
+    calculate_frame(&window_ctx);
+    update_counters(&window_ctx);
+#ifdef OPENCL_SUPPORT
+    if (window_ctx.view.cur_dev && !use_hybrid(&window_ctx.view)) swap_ocl_buffers(&window_ctx);
+#endif
 }
 
 void show_perf_result()
@@ -443,12 +353,165 @@ void show_perf_result()
 
 int draw = 1;
 int flip_window;
+int overlay; // mouse moved, only status line has to be drawn again
 int stop_animation = 1;
 int animate;
+int input; // parameters of view changed by user
 int column;
 double m1x, m1y;
 int key;
 
+void show_hsv_palette()
+{
+    int x;
+    SDL_Rect dst;
+
+    dst.w = frame_width;
+    dst.x = 0;
+    dst.y = 0;
+    dst.h = frame_height;
+
+    SDL_SetRenderDrawColor(main_window, 0, 0, 0, 255);
+    SDL_RenderFillRect(main_window, &dst);
+
+    for (x = 0; x < frame_width; x++)
+    {
+        unsigned int c = get_color(x);
+        int r = (c & 0xff0000) >> 16;
+        int g = (c & 0x00ff00) >> 8;
+        int b = c & 0xff;
+        SDL_SetRenderDrawColor(main_window, r, g, b, 255);
+        SDL_RenderDrawLine(main_window, x, 0, x, frame_height / 2);
+
+        c |= rgb;
+        r = (c & 0xff0000) >> 16;
+        g = (c & 0x00ff00) >> 8;
+        b = c & 0xff;
+        SDL_SetRenderDrawColor(main_window, r, g, b, 255);
+        SDL_RenderDrawLine(main_window, x, frame_height / 2, x, frame_height - 40);
+    }
+}
+
+// disks of rgb palettes fill 640x640 pixels, they are scaled down to fit smaller frames
+float rgb_palette_scale()
+{
+    int size = frame_width < frame_height ? frame_width : frame_height;
+
+    return size < 640 ? size / 640.0f : 1.0f;
+}
+
+void show_rgb_palette1()
+{
+    unsigned char* pixels;
+    int pitch, x, y;
+    int nx, ny;
+    float scale = rgb_palette_scale();
+    int rad = 255 * scale, p1 = 256 * scale, p2 = 320 * scale, p3 = 384 * scale;
+
+    SDL_Rect window_rec;
+    SDL_LockTexture(texture, NULL, (void**)&pixels, &pitch);
+
+    window_rec.w = frame_width;
+    window_rec.h = frame_height;
+    window_rec.x = 0;
+    window_rec.y = 0;
+    memset(pixels, 0, pitch * frame_height);
+    for (y = -rad; y <= rad; y++)
+    {
+        for (x = -rad; x <= rad; x++)
+        {
+            int r = sqrt(x * x + y * y) / scale;
+            if (r < 256)
+            {
+                r = (255 - r) * mm;
+                nx = (p1 + x) << 2;
+                ny = pitch * (p1 + y);
+                pixels[ny + nx + 2] |= (r | (rgb & 255));
+                pixels[ny + nx + 3] = 255;
+
+                nx = (p3 + x) << 2;
+                ny = pitch * (p1 + y);
+                pixels[ny + nx + 1] |= (r | ((rgb & 0x00ff00) >> 8));
+                pixels[ny + nx + 3] = 255;
+
+                nx = (p2 + x) << 2;
+                ny = pitch * (p3 + y);
+                pixels[ny + nx] |= (r | ((rgb & 0xff0000) >> 16));
+                pixels[ny + nx + 3] = 255;
+            }
+        }
+    }
+    SDL_UnlockTexture(texture);
+    SDL_RenderCopy(main_window, texture, NULL, &window_rec);
+}
+
+void show_rgb_palette2()
+{
+    unsigned char* pixels;
+    int pitch, x, y;
+    int nx, ny;
+    float scale = rgb_palette_scale();
+    int rad = 255 * scale, p1 = 256 * scale, p2 = 320 * scale, p3 = 384 * scale;
+
+    SDL_Rect window_rec;
+    SDL_LockTexture(texture, NULL, (void**)&pixels, &pitch);
+
+    window_rec.w = frame_width;
+    window_rec.h = frame_height;
+    window_rec.x = 0;
+    window_rec.y = 0;
+    memset(pixels, 0, pitch * frame_height);
+    for (y = -rad; y <= rad; y++)
+    {
+        for (x = -rad; x <= rad; x++)
+        {
+            unsigned int r = sqrt(x * x + y * y) / scale;
+            if (r < 256)
+            {
+                float cf;
+                r = 255 - r;
+                cf = 1.0 * r / 255.0;
+                r = 255 * (c1[2] + c2[2] * cos(6.2830 * (c3[2] * cf + c4[2])));
+                nx = (p1 + x) << 2;
+                ny = pitch * (p1 + y);
+                pixels[ny + nx + 2] |= r;
+                pixels[ny + nx + 3] = 255;
+
+                r = 255 * (c1[1] + c2[1] * cos(6.2830 * (c3[1] * cf + c4[1])));
+                nx = (p3 + x) << 2;
+                ny = pitch * (p1 + y);
+                pixels[ny + nx + 1] |= r;
+                pixels[ny + nx + 3] = 255;
+
+                r = 255 * (c1[0] + c2[0] * cos(6.2830 * (c3[0] * cf + c4[0])));
+                nx = (p2 + x) << 2;
+                ny = pitch * (p3 + y);
+                pixels[ny + nx] |= r;
+                pixels[ny + nx + 3] = 255;
+            }
+        }
+    }
+    SDL_UnlockTexture(texture);
+    SDL_RenderCopy(main_window, texture, NULL, &window_rec);
+}
+
+void show_palette()
+{
+    switch (pal)
+    {
+    case 0: // HSV
+        show_hsv_palette();
+        break;
+    case 1: // RGB
+        show_rgb_palette1();
+        break;
+    case 2: // RGB
+        show_rgb_palette2();
+        break;
+    }
+    SDL_RenderPresent(main_window);
+}
+
 void draw_palettes()
 {
     draw = 0;
@@ -469,66 +532,63 @@ void outside()
     stop_animation = 1;
 }
 
-void draw_fractals()
+// iterations of pixel of shown frame, -1 if frame doesn't have iterations on host
+int shown_iterations_at(int x, int y)
+{
+    if (shown_view.fractal == DRAGON || shown_view.device_color) return -1;
+    if (x >= frame_width) x = frame_width - 1;
+    if (y >= frame_height) y = frame_height - 1;
+    return ((unsigned int*)shown_iterations)[(size_t)y * frame_width + x];
+}
+
+void present_window()
 {
     float m2x, m2y;
-    unsigned long tp1, tp2;
     SDL_Rect window_rec;
 
-    window_rec.w = WIDTH;
-    window_rec.h = HEIGHT;
+    window_rec.w = frame_width;
+    window_rec.h = frame_height;
     window_rec.x = 0;
     window_rec.y = 0;
 
-    flip_window = 0;
-
-    prepare_frames();
-    tp1 = get_time_usec();
-
-    int pitch;
-    SDL_LockTexture(texture, NULL, &texture_pixels, &pitch);
-    if (pitch * HEIGHT != IMAGE_SIZE) printf("wrong pitch=%d -> %d\n", pitch, IMAGE_SIZE / HEIGHT);
-
-#ifdef OPENCL_SUPPORT
-    if (cur_dev)
-    {
-        update_gpu_texture(postprocess);
-    }
-    else
-#endif
-    {
-        if (postprocess)
-        {
-            make_postprocess(cpu_pixels);
-        }
-        else
-        {
-            memcpy(texture_pixels, cpu_pixels, IMAGE_SIZE);
-        }
-    }
-    SDL_UnlockTexture(texture);
     SDL_RenderCopy(main_window, texture, NULL, &window_rec);
 
-    m2x = equation(m1x, 0.0f, lx, WIDTH_FL, rx);
-    m2y = equation(m1y, 0.0f, ty, HEIGHT_FL, by);
+    update_bounds();
+    m2x = equation(m1x, 0.0f, lx, frame_width, rx);
+    m2y = equation(m1y, 0.0f, ty, frame_height, by);
 
     draw_right_panel(column);
     if (performance_test)
     {
         column++;
-        column %= WIDTH;
+        column %= frame_width;
     }
 
-    prepare_cpu_args();
-    sprintf(status_line, "[%2.20f,%2.20f] %s: %s iter=%d mod1=%d post=%d", m2x, m2y, cur_dev ? "OCL" : "CPU", fractals_names[fractal],
-            calculate_one_pixel(m1x / 4, m1y / 4), mod1, postprocess);
-    write_text(status_line, 0, HEIGHT - FONT_SIZE);
+    sprintf(status_line, "[%2.20f,%2.20f] %s: %s iter=%d mod1=%d post=%d", m2x, m2y,
+            use_hybrid(&shown_view) ? "CPU+OCL" : shown_view.cur_dev ? "OCL" : "CPU", fractals_names[fractal], shown_iterations_at(m1x, m1y), mod1,
+            postprocess);
+    write_text(status_line, 0, frame_height - FONT_SIZE);
 #ifdef OPENCL_SUPPORT
-    if (cur_dev)
+    if ((shown_view.cur_dev || use_hybrid(&shown_view)) && shown_view.multi_device && shown_view.fractal != DRAGON)
+    {
+        int d, len;
+
+        len = sprintf(status_line, "OCL[all %d]:", nr_devices);
+        for (d = 0; d < nr_devices && len < 150; d++)
+        {
+            struct ocl_device* dev = &ocl_devices[d];
+            // bands are split again by render thread for next frame
+            int rows = __atomic_load_n(&dev->band_end, __ATOMIC_RELAXED) - __atomic_load_n(&dev->band_start, __ATOMIC_RELAXED);
+
+            len += snprintf(status_line + len, sizeof(status_line) - len, " %.20s %d%%", dev->name, 100 * rows / shown_view.gws_y);
+        }
+        write_text(status_line, 0, frame_height - 2 * FONT_SIZE);
+    }
+    else if (shown_view.cur_dev || use_hybrid(&shown_view))
     {
-        sprintf(status_line, "OCL[%d/%d]: %s %s ", current_device + 1, nr_devices, ocl_devices[current_device].name,
-                ocl_devices[current_device].fp64 ? "fp64" : "fp32");
-        write_text(status_line, 0, HEIGHT - 2 * FONT_SIZE);
+        sprintf(status_line, "OCL[%d/%d]: %s %s ", shown_view.device + 1, nr_devices, ocl_devices[shown_view.device].name,
+                ocl_devices[shown_view.device].fp64 ? "fp64" : "fp32");
+        write_text(status_line, 0, frame_height - 2 * FONT_SIZE);
     }
 #endif
     if (show_iterations)
@@ -537,12 +597,223 @@ void draw_fractals()
     }
 
     SDL_RenderPresent(main_window);
+    last_present = get_time_usec();
+}
+
+// rows [y1, y2) of shown iterations are colored directly in locked part of texture
+void color_texture(struct view* v, int y1, int y2)
+{
+    SDL_Rect rect = {0, y1, frame_width, y2 - y1};
+    int pitch;
+
+    if (SDL_LockTexture(texture, &rect, &texture_pixels, &pitch)) return;
+    color_rows(&shown_palette, v, (char*)shown_iterations + y1 * FRAME_PITCH(v), FRAME_PITCH(v), texture_pixels, pitch, frame_width, y2 - y1);
+    SDL_UnlockTexture(texture);
+    texture_pixels = NULL;
+}
+
+// only changed rows are copied, render thread can reuse its buffers for next frame
+void copy_rows_to_texture(void* data, int y1, int y2, void* rows)
+{
+    struct view* v = data;
+
+    memcpy((char*)shown_iterations + y1 * FRAME_PITCH(v), rows, (y2 - y1) * FRAME_PITCH(v));
+    if (!v->equalize) color_texture(v, y1, y2);
+}
+
+// rows colored by OCL devices, shown iterations aren't updated
+void copy_colors_to_texture(void* data, int y1, int y2, void* rows)
+{
+    SDL_Rect rect = {0, y1, frame_width, y2 - y1};
+
+    SDL_UpdateTexture(texture, &rect, rows, FRAME_PITCH((struct view*)data));
+}
+
+// copy frame described by v from CPU memory or OCL buffers to texture
+void update_texture(struct view* v)
+{
+    shown_histogram_valid = 0;
+#ifdef OPENCL_SUPPORT
+    if (v->cur_dev && !use_hybrid(v) && !v->stored)
+        read_frame_ocl(v, v->device_color ? copy_colors_to_texture : copy_rows_to_texture, v);
+    else
+#endif
+        copy_rows_to_texture(v, 0, frame_height, cpu_pixels);
+    // histogram of whole frame is needed
+    if (v->equalize) color_texture(v, 0, frame_height);
+}
+
+// palette changed, shown frame is colored from its iterations without calculation
+void recolor_frame()
+{
+    apply_palette(&shown_view);
+    color_texture(&shown_view, 0, frame_height);
+    present_window();
+}
+
+// frame calculated by OCL devices in own buffers can be read while next one is calculated
+int pipelined_view(struct view* v)
+{
+#ifdef OPENCL_SUPPORT
+    return v->cur_dev && !use_hybrid(v) && !v->stored && pipelined_ocl(v);
+#else
+    return 0;
+#endif
+}
+
+// frame calculated on CPU can be shown before it's finished
+int partial_view(struct view* v) { return !v->cur_dev || use_hybrid(v); }
+
+/* render thread calculates frames described by views posted by UI thread,
+   UI thread keeps handling events and presents frames when they are ready */
+void* render_thread(void* p)
+{
+#ifdef OPENCL_SUPPORT
+    struct view last = {0};
+#endif
+
+    pthread_mutex_lock(&render_lock);
+    while (!render_finish)
+    {
+        if (!view_posted)
+        {
+            pthread_cond_wait(&render_cond, &render_lock);
+            continue;
+        }
+        window_ctx.view = next_view;
+        // stored frames are filled in CPU buffer, so they aren't pipelined
+        if (stored_data) stored_view(stored_data, &window_ctx.view);
+        view_posted = 0;
+        rendering = 1;
+        // buffers of frame which isn't presented yet can be reused only by pipelined OCL devices
+        while (frame_done && !pipelined_view(&window_ctx.view) && !render_finish) pthread_cond_wait(&render_cond, &render_lock);
+        pthread_mutex_unlock(&render_lock);
+
+#ifdef OPENCL_SUPPORT
+        // dragon is drawn on cleared buffer
+        if (window_ctx.view.cur_dev && window_ctx.view.fractal == DRAGON && (last.fractal != DRAGON || !last.cur_dev || last.device != window_ctx.view.device))
+            clear_pixels_ocl(window_ctx.view.device);
+        last = window_ctx.view;
+#endif
+        if (window_ctx.view.stored)
+            calculate_stored_frame(&window_ctx, stored_data);
+        else
+            calculate_frame(&window_ctx);
+        update_counters(&window_ctx);
+
+        pthread_mutex_lock(&render_lock);
+        if (frame_cancelled(&window_ctx)) continue; // newer view is already posted
+
+        // buffers of previous frame can be still read by UI thread
+        while (frame_done && !render_finish) pthread_cond_wait(&render_cond, &render_lock);
+#ifdef OPENCL_SUPPORT
+        if (window_ctx.view.cur_dev && !use_hybrid(&window_ctx.view) && !window_ctx.view.stored) swap_ocl_buffers(&window_ctx);
+#endif
+        done_view = window_ctx.view;
+        frame_done = 1;
+        rendering = 0;
+    }
+    pthread_mutex_unlock(&render_lock);
+    return NULL;
+}
+
+int start_render_thread()
+{
+    view_posted = 0;
+    rendering = 0;
+    frame_done = 0;
+    render_finish = 0;
+    if (pthread_mutex_init(&render_lock, NULL)) return 1;
+    if (pthread_cond_init(&render_cond, NULL)) return 1;
+    if (pthread_create(&render_tid, NULL, render_thread, NULL)) return 1;
+    return 0;
+}
+
+void stop_render_thread()
+{
+    pthread_mutex_lock(&render_lock);
+    render_finish = 1;
+    pthread_cond_broadcast(&render_cond);
+    pthread_mutex_unlock(&render_lock);
+    pthread_join(render_tid, NULL);
+    pthread_cond_destroy(&render_cond);
+    pthread_mutex_destroy(&render_lock);
+}
+
+// both states are taken at once, idle render thread doesn't change them until next view is posted
+int frame_ready(int* busy)
+{
+    int ready;
+
+    pthread_mutex_lock(&render_lock);
+    ready = frame_done;
+    *busy = view_posted || rendering;
+    pthread_mutex_unlock(&render_lock);
+    return ready;
+}
+
+// new view replaces view not taken yet and cancels frame being calculated
+void post_view(struct view* v)
+{
+    pthread_mutex_lock(&render_lock);
+    v->generation = __atomic_add_fetch(&generation, 1, __ATOMIC_RELAXED);
+    next_view = *v;
+    view_posted = 1;
+    pthread_cond_broadcast(&render_cond);
+    pthread_mutex_unlock(&render_lock);
+}
+
+void release_frame()
+{
+    pthread_mutex_lock(&render_lock);
+    frame_done = 0;
+    pthread_cond_broadcast(&render_cond);
+    pthread_mutex_unlock(&render_lock);
+}
+
+void present_frame()
+{
+    unsigned long tp1, tp2;
+
+    tp1 = get_time_usec();
+    shown_view = done_view;
+    apply_palette(&shown_view);
+    update_texture(&shown_view);
+    release_frame();
+    present_window();
     tp2 = get_time_usec();
 
     render_time = tp2 - tp1;
     render_times += render_time;
     flips++;
-    // printf("render time=%lu\n", tp2 - tp1);
+}
+
+void present_partial()
+{
+    shown_view = posted_view;
+    apply_palette(&shown_view);
+    update_texture(&shown_view);
+    present_window();
+}
+
+// apply animation and take snapshot of parameters for next frame
+void next_frame(struct view* v)
+{
+    if (animate || key)
+    {
+        if (calculate_offsets()) outside();
+    }
+    snapshot_view(v);
+    posted_view = *v;
+
+    input = 0;
+    flip_window = 0;
+    if (!animate) draw = 0;
+    if (key)
+    {
+        draw = 0;
+        key = 0;
+    }
 }
 
 int keyboard_event(SDL_Event* event)
@@ -582,7 +853,8 @@ int keyboard_event(SDL_Event* event)
     case 'k':
     case 'l':
         change_fractal_colors(kl, event->key.keysym.mod);
-        break;
+        recolor = 1;
+        return 0;
     case SDLK_LEFT:
     case SDLK_RIGHT:
     case SDLK_DOWN:
@@ -599,15 +871,24 @@ int keyboard_event(SDL_Event* event)
         break;
     case '1':
         show_iterations ^= 1;
-        break;
+        // frames colored on device don't have iterations on host, so they are calculated again
+        if (shown_view.device_color) break;
+        present_window();
+        return 0;
     case '2':
         postprocess ^= 1;
-        break;
+        recolor = 1;
+        return 0;
+    case '3':
+        equalize ^= 1;
+        recolor = 1;
+        return 0;
 #ifdef OPENCL_SUPPORT
     case 'v':
+        if (__atomic_load_n(&ocl_state, __ATOMIC_ACQUIRE) != OCL_READY) break;
 
         cur_dev++;
-        if (cur_dev > nr_devices)
+        if (cur_dev > __atomic_load_n(&nr_devices, __ATOMIC_ACQUIRE))
         {
             cur_dev = 0; // switch to CPU
             iter_limit = 43000000000000LL;
@@ -619,6 +900,16 @@ int keyboard_event(SDL_Event* event)
         }
         clear_counters();
         break;
+    case 'b':
+        if (__atomic_load_n(&ocl_state, __ATOMIC_ACQUIRE) != OCL_READY) break;
+        multi_device ^= 1;
+        clear_counters();
+        break;
+    case 'o':
+        if (__atomic_load_n(&ocl_state, __ATOMIC_ACQUIRE) != OCL_READY) break;
+        hybrid ^= 1;
+        clear_counters();
+        break;
 #endif
     case SDLK_SPACE:
         performance_test ^= 1;
@@ -635,6 +926,7 @@ int keyboard_event(SDL_Event* event)
     }
     draw = 1;
     draw_frames = 16;
+    input = 1;
 
     return 0;
 }
@@ -645,19 +937,16 @@ void mouse_event(SDL_Event* event)
 
     if (event->type == SDL_MOUSEMOTION)
     {
-        if (event->button.x > WIDTH) return;
+        if (event->button.x > frame_width) return;
         m1x = event->button.x;
         m1y = event->button.y;
-        if (!performance_test)
-        {
-            flip_window = 1;
-            draw_frames = 1;
-        }
+        overlay = 1;
     }
 
     if (event->type == SDL_MOUSEBUTTONDOWN)
     {
-        if (event->button.x > WIDTH) return;
+        if (event->button.x > frame_width) return;
+        input = 1;
         if (event->button.button == 2)
         {
             zx = 1.0;
@@ -670,8 +959,8 @@ void mouse_event(SDL_Event* event)
             return;
         }
 
-        mx = equation(event->button.x, 0, ofs_lx, WIDTH, ofs_rx);
-        my = equation(event->button.y % (HEIGHT), 0, ofs_ty, HEIGHT, ofs_by);
+        mx = equation(event->button.x, 0, ofs_lx, frame_width, ofs_rx);
+        my = equation(event->button.y % (frame_height), 0, ofs_ty, frame_height, ofs_by);
 
         if (event->button.button == 3)
         {
@@ -741,19 +1030,75 @@ int handle_events()
     return 0;
 }
 
+#ifdef OPENCL_SUPPORT
+void select_ocl_device(int device)
+{
+    cur_dev = 1; // use first OCL device
+    if (device >= 0 && device < __atomic_load_n(&nr_devices, __ATOMIC_ACQUIRE)) current_device = device;
+    iter_limit = ocl_devices[current_device].fp64 ? 43000000000000LL : 300000;
+}
+
+int check_ocl_init()
+{
+    static int steps_done = -1;
+    static enum ocl_states state = OCL_INIT;
+
+    if (state != OCL_INIT) return 0;
+
+    state = __atomic_load_n(&ocl_state, __ATOMIC_ACQUIRE);
+    if (state == OCL_READY)
+    {
+        if (!quiet) printf("switching to OpenCL device\n");
+        select_ocl_device(preferred_device);
+        clear_counters();
+        draw = 1;
+        draw_frames = 16;
+        return 0;
+    }
+    if (state == OCL_FAILED || steps_done != ocl_steps_done)
+    {
+        steps_done = ocl_steps_done;
+        return 1; // only panel needs to be updated
+    }
+    return 0;
+}
+#endif
+
 void gui_loop()
 {
-    /*    unsigned long tp1=0, tp2=0;
-        unsigned long tms;*/
+    struct view next;
+    int ready, busy;
+
     init_window();
+    if (start_render_thread())
+    {
+        printf("can't start render thread\n");
+        return;
+    }
 
     while (1)
     {
+#ifdef OPENCL_SUPPORT
+        if (check_ocl_init() && !flip_window && !draw && !palette) present_window();
+#endif
 
         if (palette) draw_palettes();
-        if (animate || key)
+        if (overlay)
         {
-            if (calculate_offsets()) outside();
+            overlay = 0;
+            // frame is presented anyway when it's calculated
+            if (!draw && !flip_window && !palette && !performance_test) present_window();
+        }
+        if (recolor)
+        {
+            recolor = 0;
+            // dragon and frames colored on device don't have iterations on host, so they are calculated again
+            if (shown_view.fractal == DRAGON || (shown_view.device_color && (!postprocess || equalize)))
+                draw = 1;
+            else if (shown_view.device_color)
+                present_window(); // palette doesn't change postprocessed colors
+            else
+                recolor_frame();
         }
         if (fractal == DRAGON || fractal == JULIA_FULL) draw_frames = 1;
         if (draw || stop_animation)
@@ -761,35 +1106,49 @@ void gui_loop()
             stop_animation = 0;
             flip_window = 1;
         }
-        else
-        {
-            SDL_Delay(1);
-        }
 
-        if (flip_window || performance_test || show_iterations)
+        ready = frame_ready(&busy);
+        // new input cancels frame being calculated, animation waits for it
+        if ((flip_window || performance_test) && (!busy || input))
         {
-            //            tp1 = get_time_usec();
-            draw_fractals();
-            /*          tp2 = get_time_usec();
-                      tms = (tp2 - tp1);
-                      printf("time = %lu fps=%lu\n", tms, tms ? 1000000/tms : 0);*/
-        }
-        if (!animate) draw = 0;
-        if (key)
-        {
-            draw = 0;
-            key = 0;
+            next_frame(&next);
+            // OCL buffers of previous frame are read while kernels calculate next one
+            if (ready && !(pipelined_view(&done_view) && pipelined_view(&next)))
+            {
+                present_frame();
+                ready = 0;
+            }
+            post_view(&next);
+            busy = 1;
         }
 
+        if (ready)
+            present_frame();
+        else if (busy && partial_view(&posted_view) && get_time_usec() - last_present > PARTIAL_FRAME_TIME)
+            present_partial();
+        else
+            SDL_Delay(1);
+
         if (handle_events()) break;
     }
+    stop_render_thread();
 }
 
 void run_test()
 {
     unsigned long exec_time;
+
+    snapshot_view(&window_ctx.view);
 #ifdef OPENCL_SUPPORT
-    if (cur_dev)
+    if (use_hybrid(&window_ctx.view))
+    {
+        printf("starting performance test with %u iterations on CPU and %s\n", draw_frames, multi_device ? "all devices" : "OCL device");
+    }
+    else if (cur_dev && multi_device)
+    {
+        printf("starting performance test with %u iterations for all devices\n", draw_frames);
+    }
+    else if (cur_dev)
     {
         printf("starting performance test with %u iterations for device: %d\n", draw_frames, current_device);
     }
@@ -799,7 +1158,7 @@ void run_test()
         printf("starting performance test with %u iterations on CPU\n", draw_frames);
     }
     prepare_frames();
-    last_avg_result = calculate_avg_time(&exec_time);
+    last_avg_result = calculate_avg_time(&window_ctx.view, &window_ctx, &exec_time);
     show_perf_result();
     clear_counters();
 }
@@ -827,7 +1186,27 @@ void perf_test()
 void run_program(enum app_modes app_mode, int device)
 {
 #ifdef OPENCL_SUPPORT
-    if (init_ocl())
+    pthread_t init_tid;
+#endif
+
+    if (initialize_colors()) return;
+    if (posix_memalign((void**)&cpu_pixels, 4096, (size_t)frame_width * frame_height * BPP)) return;
+    shown_iterations = calloc(1, (size_t)frame_width * frame_height * BPP);
+    shown_histogram = calloc(frame_width + 1, sizeof(unsigned int));
+    if (!shown_iterations || !shown_histogram) return;
+    window_ctx.pixels = cpu_pixels;
+    window_ctx.colors = colors;
+    window_ctx.generation = &generation;
+
+#ifdef OPENCL_SUPPORT
+    if (app_mode == APP_GUI)
+    {
+        // show first frames on CPU, switch to OCL device when its kernels are ready
+        cur_dev = 0;
+        preferred_device = device;
+        if (pthread_create(&init_tid, NULL, init_ocl_thread, NULL)) return;
+    }
+    else if (init_ocl_devices())
     {
         printf("OpenCL device not found, using CPU only\n");
     }
@@ -838,33 +1217,25 @@ void run_program(enum app_modes app_mode, int device)
             show_ocl_devices();
             return;
         }
-        if (app_mode == APP_TEST)
+        if (device == -2)
         {
-            if (device == -2)
-            {
-                cur_dev = 0;
-                current_device = 0;
-            }
-            else
-            {
-                cur_dev = 1; // use first OCL device
-                if (device >= 0 && device < nr_devices) current_device = device;
-            }
+            cur_dev = 0;
+            current_device = 0;
         }
         else
         {
-            cur_dev = 1; // use first OCL device
-            if (device >= 0 && device < nr_devices) current_device = device;
+            select_ocl_device(device);
         }
-        iter_limit = ocl_devices[current_device].fp64 ? 43000000000000LL : 300000;
-        if (pthread_mutex_init(&lock_fin, NULL)) return;
-        if (pthread_cond_init(&cond_fin, NULL)) return;
     }
 #endif
-    if (initialize_colors()) return;
-    if (posix_memalign((void**)&cpu_pixels, 4096, IMAGE_SIZE)) return;
 
-    if (!console_mode)
+    if (app_mode == APP_TUNE)
+    {
+#ifdef OPENCL_SUPPORT
+        if (autotune()) printf("autotuning failed\n");
+#endif
+    }
+    else if (!console_mode)
     {
         gui_loop();
     }
@@ -874,17 +1245,44 @@ void run_program(enum app_modes app_mode, int device)
     }
 #ifdef OPENCL_SUPPORT
     finish_thread = 1;
-    if (nr_devices)
+    // programs still compiled in background aren't waited for, process exits with them
+    if (app_mode == APP_GUI && __atomic_load_n(&ocl_state, __ATOMIC_ACQUIRE) == OCL_INIT)
+        pthread_detach(init_tid);
+    else
     {
-        pthread_mutex_destroy(&lock_fin);
-        pthread_cond_destroy(&cond_fin);
+        if (app_mode == APP_GUI) pthread_join(init_tid, NULL);
+        close_ocl();
     }
-    close_ocl();
 #endif
 
     if (!console_mode) SDL_Quit();
 }
 
+// window starts with view of iteration file, its width fits in frame
+int load_stored(const char* path)
+{
+    const struct fci_header* h;
+    FP_TYPE step, cy;
+
+    stored_data = open_iter_file(path);
+    if (!stored_data) return 1;
+    h = iter_file_header(stored_data);
+    select_fractal(h->fractal);
+    step = (h->x2 - h->x1) / frame_width;
+    cy = (h->y1 + h->y2) / 2;
+    ofs_lx = h->x1;
+    ofs_rx = h->x2;
+    ofs_ty = cy + step * frame_height / 2;
+    ofs_by = cy - step * frame_height / 2;
+    c_x = h->c_x;
+    c_y = h->c_y;
+    er = h->er;
+    max_iter = h->max_iter;
+    mod1 = h->mod1;
+    if (!quiet) printf("iteration file %s: %ux%u, %u levels, fractal %d\n", path, h->width, h->height, h->levels, h->fractal);
+    return 0;
+}
+
 void help()
 {
 #ifdef OPENCL_SUPPORT
@@ -892,12 +1290,17 @@ void help()
     puts("-c  - run performance test on CPU");
     puts("-l  - list OpenCL devices");
     puts("-a  - test all OpenCL devices");
+    puts("-m  - split every frame between all OpenCL devices");
+    puts("-H  - calculate every frame on CPU and OpenCL device(s) together");
+    puts("-T  - tune local work size and build options, results are saved in ~/.FractalCL.tuning");
 #endif
     puts("-t  - run performance test on GPU/CPU");
     puts("-i  - number of iterations in performance test");
     puts("-q  - quiet mode - disable logs");
     puts("-h  - show help");
     puts("-v  - show version");
+    puts("-s WxH - size of frame, default 1024x768");
+    puts("-L file - browse iteration file rendered by FractalCL-batch, only missing points are calculated");
     puts("-fn - select n fractal type");
     puts("where n:");
     puts("      0 - julia");
@@ -917,10 +1320,11 @@ int main(int argc, char* argv[])
     enum app_modes app_mode = APP_GUI;
     int f;
     int iter = 32000;
+    const char* stored_path = NULL;
 #ifdef OPENCL_SUPPORT
-    while ((opt = getopt(argc, argv, "d:tlhi:qaf:vc")) != -1)
+    while ((opt = getopt(argc, argv, "d:tlhi:qaf:vcmHTs:L:")) != -1)
 #else
-    while ((opt = getopt(argc, argv, "thi:qf:v")) != -1)
+    while ((opt = getopt(argc, argv, "thi:qf:vs:L:")) != -1)
 #endif
     {
         switch (opt)
@@ -941,6 +1345,16 @@ int main(int argc, char* argv[])
         case 'a':
             all_devices = 1;
             break;
+        case 'm':
+            multi_device = 1;
+            break;
+        case 'H':
+            hybrid = 1;
+            break;
+        case 'T':
+            app_mode = APP_TUNE;
+            console_mode = 1;
+            break;
         case 'c':
             app_mode = APP_TEST;
             performance_test = 1;
@@ -977,8 +1391,23 @@ int main(int argc, char* argv[])
         case 'v':
             printf("FractalCL version: %s\n", STRING_MACRO(VERSION));
             return 0;
+        case 's':
+            if (sscanf(optarg, "%dx%d", &frame_width, &frame_height) != 2 || frame_width < 16 || frame_height < 16)
+            {
+                printf("wrong size of frame: %s\n", optarg);
+                return 1;
+            }
+            // sub-frames need multiples of 4
+            frame_width = (frame_width + 3) & ~3;
+            frame_height = (frame_height + 3) & ~3;
+            select_fractal(fractal);
+            break;
+        case 'L':
+            stored_path = optarg;
+            break;
         }
     }
+    if (stored_path && load_stored(stored_path)) return 1;
     if (console_mode && app_mode == APP_TEST)
     {
         draw_frames = iter;
@@ -986,5 +1415,6 @@ int main(int argc, char* argv[])
     srandom(time(0));
 
     run_program(app_mode, device);
+    if (stored_data) close_iter_file(stored_data);
     return 0;
 }
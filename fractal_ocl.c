@@ -16,34 +16,87 @@
 */
 
 #include "fractal_ocl.h"
-#include "gui.h"
 #include "palette.h"
-#include "parameters.h"
+#include "render.h"
 #include "timer.h"
 
 int finish_thread;
-pthread_cond_t cond_fin;
-pthread_mutex_t lock_fin;
-volatile int tasks_finished;
+enum ocl_states ocl_state;
+int multi_device; // split every frame between all OCL devices
 
 extern unsigned int* colors;
 extern int quiet;
 
-int prepare_pixels(struct ocl_device* dev)
+/* pixel buffers of device for frames of width x height pixels, allocated before the first frame
+   and again when size of frame changes, frame kept in previous buffers is lost */
+int prepare_pixels(struct ocl_device* dev, int width, int height)
 {
-    int err;
+    size_t size = (size_t)width * height * BPP;
+    int err, b;
+
     if (!dev->initialized) return 0;
-    void* pixels;
+    if (dev->width == width && dev->height == height) return 0;
+    release_pixels(dev);
 
-    if (posix_memalign((void**)&pixels, 4096, IMAGE_SIZE)) return 1;
-    dev->cl_pixels = clCreateBuffer(dev->ctx, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, IMAGE_SIZE, pixels, &err);
+    dev->calc = 0;
+    if (dev->zero_copy)
+    {
+        // kernels write directly to host memory, mapping doesn't copy it
+        if (posix_memalign((void**)&dev->host_pixels, 4096, size)) return 1;
+        if (posix_memalign((void**)&dev->host_argb, 4096, size)) return 1;
+        memset(dev->host_pixels, 0, size);
+        dev->nr_buffers = 1;
+        dev->buffers[0].pixels = clCreateBuffer(dev->ctx, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, size, dev->host_pixels, &err);
+        if (err == CL_SUCCESS) dev->buffers[0].argb = clCreateBuffer(dev->ctx, CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR, size, dev->host_argb, &err);
+    }
+    else
+    {
+        void* zero = calloc(1, size);
+
+        if (!zero) return 1;
+        dev->nr_buffers = PIPELINE_DEPTH;
+        for (b = 0, err = CL_SUCCESS; b < dev->nr_buffers && err == CL_SUCCESS; b++)
+        {
+            dev->buffers[b].pixels = clCreateBuffer(dev->ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, size, zero, &err);
+            if (err == CL_SUCCESS) dev->buffers[b].argb = clCreateBuffer(dev->ctx, CL_MEM_WRITE_ONLY, size, NULL, &err);
+        }
+        free(zero);
+    }
 
     if (err != CL_SUCCESS)
     {
         printf("clCreateBuffer pixels returned %d\n", err);
         return 1;
     }
-    if (!quiet) printf("OCL buffer created with size=%d\n", IMAGE_SIZE);
+    if (!quiet) printf("%s: %d buffer(s) created for %dx%d frame\n", dev->name, dev->nr_buffers, width, height);
+    if (!dev->zero_copy)
+    {
+        if (!dev->read_queue) dev->read_queue = clCreateCommandQueue(dev->ctx, dev->device_id, 0, &err);
+        if (err != CL_SUCCESS)
+        {
+            printf("%s: clCreateCommandQueue for reads returned %d\n", dev->name, err);
+            return 1;
+        }
+
+        // pinned memory mapped once for frames of this size, reads from device go directly to it by DMA
+        dev->cl_staging = clCreateBuffer(dev->ctx, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, size, NULL, &err);
+        if (err != CL_SUCCESS)
+        {
+            printf("clCreateBuffer staging returned %d\n", err);
+            return 1;
+        }
+        dev->staging = clEnqueueMapBuffer(dev->queue, dev->cl_staging, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, size, 0, NULL, NULL, &err);
+        if (err != CL_SUCCESS)
+        {
+            printf("clEnqueueMapBuffer staging returned %d\n", err);
+            return 1;
+        }
+        memset(dev->staging, 0, size);
+        dev->frame = dev->compact ? calloc(1, size) : dev->staging;
+        if (!dev->frame) return 1;
+    }
+    dev->width = width;
+    dev->height = height;
     return 0;
 }
 
@@ -76,166 +129,347 @@ int set_kernel_arg(cl_kernel kernel, char* name, int i, int size, void* arg)
     return 0;
 }
 
-#ifdef FP_64_SUPPORT
-void prepare_kernel_args64(struct kernel_args64* args)
+// palette table of view is uploaded only when palette differs from the last one used by device
+int prepare_palette(struct ocl_device* dev, struct KERNEL_ARGS* args)
+{
+    size_t size = (args->max_iter + 1) * sizeof(unsigned int);
+    unsigned int* table;
+    int err;
+
+    if (dev->cl_palette && same_palette(args, &dev->palette_args)) return 0;
+    if (dev->cl_palette) clReleaseMemObject(dev->cl_palette);
+    dev->cl_palette = NULL;
+
+    table = malloc(size);
+    if (!table) return 1;
+    build_palette(args, table);
+    dev->cl_palette = clCreateBuffer(dev->ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, size, table, &err);
+    free(table);
+    if (err != CL_SUCCESS)
+    {
+        printf("%s: clCreateBuffer palette returned %d\n", dev->name, err);
+        dev->cl_palette = NULL;
+        return 1;
+    }
+    dev->palette_args = *args;
+    return 0;
+}
+
+/* numbers of iterations of whole buffer are replaced by colors in argb buffer, enqueued after kernels of frame,
+   layout of pixels doesn't matter, so colors are read like pixels */
+int color_frame_ocl(struct ocl_device* dev, struct ocl_buffer* buf, struct KERNEL_ARGS* args)
 {
-    FP_TYPE ofs_lx1, ofs_rx1, ofs_ty1, ofs_by1;
-    int c;
+    cl_kernel kernel = dev->color_kernel;
+    cl_uint size = args->max_iter + 1;
+    size_t gws = (size_t)dev->width * dev->height;
+    int err;
 
-    args->ofs_lx = ofs_lx;
-    args->ofs_rx = ofs_rx;
-    args->ofs_ty = ofs_ty;
-    args->ofs_by = ofs_by;
+    if (prepare_palette(dev, args)) return 1;
+    if (set_kernel_arg(kernel, "color_frame", 0, sizeof(cl_mem), &buf->pixels)) return 1;
+    if (set_kernel_arg(kernel, "color_frame", 1, sizeof(cl_mem), &buf->argb)) return 1;
+    if (set_kernel_arg(kernel, "color_frame", 2, sizeof(cl_mem), &dev->cl_palette)) return 1;
+    if (set_kernel_arg(kernel, "color_frame", 3, sizeof(size), &size)) return 1;
 
-    for (c = 0; c < 3; c++)
+    err = clEnqueueNDRangeKernel(dev->queue, kernel, 1, NULL, &gws, NULL, 0, NULL, NULL);
+    if (err != CL_SUCCESS)
     {
-        args->c1[c] = c1[c];
-        args->c2[c] = c2[c];
-        args->c3[c] = c3[c];
-        args->c4[c] = c4[c];
+        printf("%s: clEnqueueNDRangeKernel color_frame returned %d\n", dev->name, err);
+        return 1;
     }
+    return 0;
+}
+
+/* frame parameters are taken from view, arguments of device keep sub-frame
+   of its last pass and every pass calculates next one */
+#ifdef FP_64_SUPPORT
+void pass_args64(struct render_ctx* ctx, struct kernel_args64* args)
+{
+    int ofs_x = args->ofs_x, ofs_y = args->ofs_y;
 
-    ofs_lx1 = (args->ofs_lx + dx) / szx;
-    ofs_rx1 = (args->ofs_rx + dx) / szx;
-    ofs_ty1 = (args->ofs_ty + dy) / szy;
-    ofs_by1 = (args->ofs_by + dy) / szy;
-    lx = ofs_lx1;
-    args->ofs_lx = ofs_lx1;
-    rx = ofs_rx1;
-    ty = ofs_ty1;
-    args->ofs_ty = ofs_ty1;
-    by = ofs_by1;
+    *args = ctx->view.args;
+    args->ofs_x = ofs_x;
+    args->ofs_y = ofs_y;
+    next_subframe(&args->ofs_x, &args->ofs_y);
+}
+#endif
+void pass_args32(struct render_ctx* ctx, struct kernel_args32* args)
+{
+    int ofs_x = args->ofs_x, ofs_y = args->ofs_y;
 
-    args->step_x = (ofs_rx1 - ofs_lx1) / WIDTH_FL;
-    args->step_y = (ofs_by1 - ofs_ty1) / HEIGHT_FL;
+    *args = ctx->view.args32;
+    args->ofs_x = ofs_x;
+    args->ofs_y = ofs_y;
+    next_subframe(&args->ofs_x, &args->ofs_y);
+}
 
-    args->rgb = rgb;
-    args->mm = mm;
-    args->er = er;
-    args->max_iter = max_iter;
-    args->mod1 = mod1;
-    args->pal = pal;
-    args->c_x = c_x;
-    args->c_y = c_y;
-    args->ofs_x++;
-    if (args->ofs_x == 4)
+// local work size from tuning database, if global work size can be divided by it
+size_t* local_work_size(struct ocl_device* dev, enum fractals fractal, size_t* gws)
+{
+    size_t* lws = dev->lws[fractal];
+
+    if (!lws[0] || !lws[1]) return NULL;
+    if (gws[0] % lws[0] || gws[1] % lws[1]) return NULL;
+    return lws;
+}
+
+/* rows [y1, y2) of frame and mask of sub-frames written by one pass of kernel over rows [g1, g2)
+   of global work size, fractals calculated in full resolution write all sub-frames */
+unsigned int written_region(struct view* v, int g1, int g2, int ofs_x, int ofs_y, int* y1, int* y2)
+{
+    *y1 = 0;
+    *y2 = v->height;
+    if (v->fractal == DRAGON) return ALL_SUBFRAMES;
+
+    if (v->gws_x * 4 == v->width && v->gws_y * 4 == v->height)
     {
-        args->ofs_y++;
-        args->ofs_x = 0;
+        *y1 = 4 * g1;
+        *y2 = 4 * g2;
+        return 1 << (ofs_y * 4 + ofs_x);
     }
-    if (args->ofs_y == 4)
+    if (v->gws_y == v->height)
     {
-        args->ofs_x = 0;
-        args->ofs_y = 0;
+        *y1 = g1;
+        *y2 = g2;
     }
-    args->post_process = postprocess;
+    return ALL_SUBFRAMES;
 }
-#endif
-void prepare_kernel_args32(struct kernel_args32* args)
+
+// remember region written by kernels, it's read from device before next presentation of frame
+void mark_dirty(struct ocl_buffer* buf, int y1, int y2, unsigned int subframes)
+{
+    if (!buf->dirty_subframes)
+    {
+        buf->dirty_y1 = y1;
+        buf->dirty_y2 = y2;
+    }
+    if (y1 < buf->dirty_y1) buf->dirty_y1 = y1;
+    if (y2 > buf->dirty_y2) buf->dirty_y2 = y2;
+    buf->dirty_subframes |= subframes;
+}
+
+// copy rows [g1, g2) of selected sub-frames from compact layout to screen layout
+void deinterleave(struct ocl_device* dev, unsigned int* src, unsigned int* dst, int g1, int g2, unsigned int subframes)
+{
+    int s, gx, gy;
+    int w = dev->width / 4, h = dev->height / 4;
+
+    for (s = 0; s < 16; s++)
+    {
+        unsigned int* block = src + s * w * h;
+
+        if (!(subframes & (1 << s))) continue;
+        for (gy = g1; gy < g2; gy++)
+        {
+            unsigned int* in = block + gy * w;
+            unsigned int* out = dst + (4 * gy + s / 4) * dev->width + s % 4;
+
+            for (gx = 0; gx < w; gx++) out[4 * gx] = in[gx];
+        }
+    }
+}
+
+/* read rows [y1, y2) of selected sub-frames from device to host frame dst in screen layout
+   in compact layout every sub-frame is one continuous range of buffer read to staging memory,
+   otherwise only rows of changed sub-frames are read with rectangular reads */
+int read_region(struct ocl_device* dev, cl_command_queue queue, cl_mem pixels, int y1, int y2, unsigned int subframes, void* dst)
 {
-    float ofs_lx1, ofs_rx1, ofs_ty1, ofs_by1;
-    int c;
+    int err = CL_SUCCESS, s, p;
+    size_t pitch = dev->width * BPP;
 
-    args->ofs_lx = ofs_lx;
-    args->ofs_rx = ofs_rx;
-    args->ofs_ty = ofs_ty;
-    args->ofs_by = ofs_by;
+    if (dev->compact)
+    {
+        int g1 = y1 / 4, g2 = (y2 + 3) / 4;
 
-    for (c = 0; c < 3; c++)
+        for (s = 0; s < 16 && err == CL_SUCCESS; s++)
+        {
+            size_t offset = (s * (dev->height / 4) + g1) * (pitch / 4);
+
+            if (!(subframes & (1 << s))) continue;
+            err = clEnqueueReadBuffer(queue, pixels, CL_FALSE, offset, (g2 - g1) * (pitch / 4), (char*)dev->staging + offset, 0, NULL, NULL);
+        }
+        if (err == CL_SUCCESS) err = clFinish(queue);
+        if (err == CL_SUCCESS) deinterleave(dev, dev->staging, dst, g1, g2, subframes);
+    }
+    else
     {
-        args->c1[c] = c1[c];
-        args->c2[c] = c2[c];
-        args->c3[c] = c3[c];
-        args->c4[c] = c4[c];
+        unsigned int rows = 0; // sub-frame rows (ofs_y) to read
+
+        for (p = 0; p < 4; p++)
+            if (subframes & (0xf << (4 * p))) rows |= 1 << p;
+
+        if (rows == 0xf)
+        {
+            size_t origin[3] = {0, y1, 0};
+            size_t region[3] = {pitch, y2 - y1, 1};
+
+            err = clEnqueueReadBufferRect(queue, pixels, CL_TRUE, origin, origin, region, pitch, 0, pitch, 0, dst, 0, NULL, NULL);
+        }
+        else
+        {
+            // every 4th row starting from ofs_y, y1 and y2 are multiples of 4
+            for (p = 0; p < 4 && err == CL_SUCCESS; p++)
+            {
+                size_t origin[3] = {p * pitch, y1 / 4, 0};
+                size_t region[3] = {pitch, (y2 - y1) / 4, 1};
+
+                if (!(rows & (1 << p))) continue;
+                err = clEnqueueReadBufferRect(queue, pixels, CL_FALSE, origin, origin, region, 4 * pitch, 0, 4 * pitch, 0, dst, 0, NULL, NULL);
+            }
+            if (err == CL_SUCCESS) err = clFinish(queue);
+        }
     }
-    ofs_lx1 = (args->ofs_lx + dx) / szx;
-    ofs_rx1 = (args->ofs_rx + dx) / szx;
-    ofs_ty1 = (args->ofs_ty + dy) / szy;
-    ofs_by1 = (args->ofs_by + dy) / szy;
-    lx = ofs_lx1;
-    args->ofs_lx = ofs_lx1;
-    rx = ofs_rx1;
-    ty = ofs_ty1;
-    args->ofs_ty = ofs_ty1;
-    by = ofs_by1;
 
-    args->step_x = (ofs_rx1 - ofs_lx1) / WIDTH_FL;
-    args->step_y = (ofs_by1 - ofs_ty1) / HEIGHT_FL;
+    if (err != CL_SUCCESS)
+    {
+        printf("%s: reading pixels returned %d\n", dev->name, err);
+        return 1;
+    }
+    return 0;
+}
 
-    args->rgb = rgb;
-    args->mm = mm;
-    args->er = er;
-    args->max_iter = max_iter;
-    args->mod1 = mod1;
-    args->pal = pal;
-    args->c_x = c_x;
-    args->c_y = c_y;
-    args->ofs_x++;
-    if (args->ofs_x == 4)
+// copy pixels of selected sub-frames of rows [y1, y2) from src starting with row y1 to frame dst in screen layout
+void copy_subframes(struct ocl_device* dev, const unsigned int* src, unsigned int* dst, int y1, int y2, unsigned int subframes)
+{
+    int x, y, ofs_x;
+
+    for (y = y1; y < y2; y++)
     {
-        args->ofs_y++;
-        args->ofs_x = 0;
+        const unsigned int* in = src + (size_t)(y - y1) * dev->width;
+        unsigned int* out = dst + (size_t)y * dev->width;
+
+        for (ofs_x = 0; ofs_x < 4; ofs_x++)
+        {
+            if (!(subframes & (1 << ((y % 4) * 4 + ofs_x)))) continue;
+            for (x = ofs_x; x < dev->width; x += 4) out[x] = in[x];
+        }
+    }
+}
+
+/* read rows [y1, y2) of selected sub-frames of tile to frame dst shared with CPU threads, other sub-frames
+   of these rows can be calculated by CPU, so rows with only some of their sub-frames selected are read
+   to host memory of device and only pixels of selected sub-frames are copied to dst */
+int read_tile(struct ocl_device* dev, struct ocl_buffer* buf, int y1, int y2, unsigned int subframes, void* dst)
+{
+    size_t pitch = dev->width * BPP;
+    int p, b, err;
+
+    for (p = 0; p < 4; p++)
+    {
+        unsigned int row = (subframes >> (4 * p)) & 0xf;
+
+        if (row && row != 0xf) break;
     }
-    if (args->ofs_y == 4)
+    // compact layout is deinterleaved only for selected sub-frames
+    if (dev->compact || p == 4) return read_region(dev, dev->queue, buf->pixels, y1, y2, subframes, dst);
+
+    if (dev->zero_copy)
     {
-        args->ofs_x = 0;
-        args->ofs_y = 0;
+        void* px1 = clEnqueueMapBuffer(dev->queue, buf->pixels, CL_TRUE, CL_MAP_READ, y1 * pitch, (y2 - y1) * pitch, 0, NULL, NULL, &err);
+
+        if (err != CL_SUCCESS)
+        {
+            printf("%s: clEnqueueMapBuffer error %d\n", dev->name, err);
+            return 1;
+        }
+        copy_subframes(dev, px1, dst, y1, y2, subframes);
+        clEnqueueUnmapMemObject(dev->queue, buf->pixels, px1, 0, NULL, NULL);
+        return 0;
     }
-    args->post_process = postprocess;
+
+    if (read_region(dev, dev->queue, buf->pixels, y1, y2, subframes, dev->frame)) return 1;
+    copy_subframes(dev, (unsigned int*)((char*)dev->frame + y1 * pitch), dst, y1, y2, subframes);
+    // host frame doesn't match previous buffer in these rows anymore
+    for (b = 0; b < dev->nr_buffers; b++) mark_dirty(&dev->buffers[b], y1, y2, ALL_SUBFRAMES);
+    return 0;
 }
 
-extern int draw_frames;
-int execute_fractal(struct ocl_device* dev, enum fractals fractal)
+int multi_frame(struct view* v) { return v->multi_device && v->fractal != DRAGON; }
+
+int execute_fractal(struct ocl_device* dev, struct render_ctx* ctx)
 {
     size_t gws[2];
     size_t ofs[2] = {0, 0};
+    enum fractals fractal = ctx->view.fractal;
     cl_kernel kernel = dev->kernels[fractal];
     char* name = fractals[fractal].name;
-    int err;
+    int err = 0, ofs_x, ofs_y, y1, y2;
+    unsigned int subframes;
     unsigned long tp1, tp2;
+    struct ocl_buffer* buf = &dev->buffers[dev->calc];
 
-    gws[0] = gws_x;
-    gws[1] = gws_y;
+    gws[0] = ctx->view.gws_x;
+    gws[1] = ctx->view.gws_y;
+    if (multi_frame(&ctx->view))
+    {
+        ofs[1] = dev->band_start;
+        gws[1] = dev->band_end - dev->band_start;
+    }
 
-    if (set_kernel_arg(kernel, name, 0, sizeof(cl_mem), &dev->cl_pixels)) return 1;
+    if (set_kernel_arg(kernel, name, 0, sizeof(cl_mem), &buf->pixels)) return 1;
     if (set_kernel_arg(kernel, name, 1, sizeof(cl_mem), &dev->cl_colors)) return 1;
 
+    cl_event events[QUEUED_PASSES]; // ring of events of passes in flight, pass n uses events[n % QUEUED_PASSES]
+    int frame, queued = 0, released = 0;
+
     tp1 = get_time_usec();
-    int frame;
-    for (frame = 0; frame < draw_frames; frame++)
+    for (frame = 0; frame < ctx->view.draw_frames; frame++)
     {
+        // passes already enqueued cannot be cancelled, so keep only a few of them in flight
+        if (queued - released == QUEUED_PASSES)
+        {
+            clWaitForEvents(1, &events[released % QUEUED_PASSES]);
+            clReleaseEvent(events[released++ % QUEUED_PASSES]);
+        }
+        if (frame_cancelled(ctx)) break;
 #ifdef FP_64_SUPPORT
         if (dev->fp64)
         {
             struct kernel_args64* args64 = &dev->args64[fractal];
-            prepare_kernel_args64(args64);
-            if (set_kernel_arg(kernel, name, 2, sizeof(*args64), args64)) return 1;
+            pass_args64(ctx, args64);
+            err = set_kernel_arg(kernel, name, 2, sizeof(*args64), args64);
+            ofs_x = args64->ofs_x;
+            ofs_y = args64->ofs_y;
         }
         else
 #endif
         {
             struct kernel_args32* args32 = &dev->args32[fractal];
-            prepare_kernel_args32(args32);
-            if (set_kernel_arg(kernel, name, 2, sizeof(*args32), args32)) return 1;
+            pass_args32(ctx, args32);
+            err = set_kernel_arg(kernel, name, 2, sizeof(*args32), args32);
+            ofs_x = args32->ofs_x;
+            ofs_y = args32->ofs_y;
         }
+        if (err) break;
 
         // err = clEnqueueNDRangeKernel(dev->queue, kernel, 2, ofs, gws, NULL, 0,
         // NULL, &dev->event);
         //
         //    printf("%s: clEnqueueNDRangeKernel %s\n", dev->name, name);
 
-        err = clEnqueueNDRangeKernel(dev->queue, kernel, 2, ofs, gws, NULL, 0, NULL, NULL);
+        err = clEnqueueNDRangeKernel(dev->queue, kernel, 2, ofs, gws, local_work_size(dev, fractal, gws), 0, NULL, &events[queued % QUEUED_PASSES]);
         if (err != CL_SUCCESS)
         {
             printf("%s: clEnqueueNDRangeKernel %s returned %d\n", dev->name, name, err);
-            return 1;
+            break;
         }
+        queued++;
+        subframes = written_region(&ctx->view, ofs[1], ofs[1] + gws[1], ofs_x, ofs_y, &y1, &y2);
+        mark_dirty(buf, y1, y2, subframes);
         clFlush(dev->queue);
     }
-    // clWaitForEvents(1, &dev->event);
+    // in-order queue starts coloring when all passes are finished
+    if (!err) err = frame == ctx->view.draw_frames && ctx->view.device_color && color_frame_ocl(dev, buf, &ctx->view.args);
     clFinish(dev->queue);
+    while (released < queued) clReleaseEvent(events[released++ % QUEUED_PASSES]);
+    if (err) return 1;
+    if (frame < ctx->view.draw_frames) return 0;
     tp2 = get_time_usec();
-    dev->execution = (tp2 - tp1) / draw_frames;
+    dev->execution = (tp2 - tp1) / ctx->view.draw_frames;
+    if (dev->execution)
+    {
+        double pps = 1000000.0 * gws[0] * gws[1] / dev->execution;
+        dev->pps = dev->pps ? (3 * dev->pps + pps) / 4 : pps;
+    }
 
     //  clReleaseEvent(dev->event);
 
@@ -243,52 +477,105 @@ int execute_fractal(struct ocl_device* dev, enum fractals fractal)
     return 0;
 }
 
-void* ocl_kernel(void* d)
+int execute_tiles(struct ocl_device* dev, struct render_ctx* ctx)
 {
-    struct ocl_device* dev = (struct ocl_device*)d;
-    struct ocl_thread* t = &dev->thread;
-    int err = 0;
+    size_t gws[2];
+    size_t ofs[2] = {0, 0};
+    enum fractals fractal = ctx->view.fractal;
+    cl_kernel kernel = dev->kernels[fractal];
+    char* name = fractals[fractal].name;
+    int err, start, end, frame, ofs_x, ofs_y, y1, y2;
+    unsigned int subframes;
+    struct ocl_buffer* buf = &dev->buffers[dev->calc];
 
-    while (!finish_thread && !err)
+    if (set_kernel_arg(kernel, name, 0, sizeof(cl_mem), &buf->pixels)) return 1;
+    if (set_kernel_arg(kernel, name, 1, sizeof(cl_mem), &dev->cl_colors)) return 1;
+
+    while (!frame_cancelled(ctx) && get_tile(ctx, &start, &end))
     {
-        pthread_mutex_lock(&t->lock);
-        while (!t->work)
+        gws[0] = ctx->view.gws_x;
+        gws[1] = end - start;
+        ofs[1] = start;
+        subframes = 0;
+
+        for (frame = 0; frame < ctx->view.draw_frames; frame++)
         {
-            //            printf("%s: waiting for work\n", dev->name);
-            if (finish_thread)
+#ifdef FP_64_SUPPORT
+            if (dev->fp64)
+            {
+                struct kernel_args64* args64 = &dev->args64[fractal];
+                pass_args64(ctx, args64);
+                set_subframe(ctx, frame, &args64->ofs_x, &args64->ofs_y);
+                if (set_kernel_arg(kernel, name, 2, sizeof(*args64), args64)) return 1;
+                ofs_x = args64->ofs_x;
+                ofs_y = args64->ofs_y;
+            }
+            else
+#endif
             {
-                if (!quiet) printf("%s: thread exits\n", dev->name);
-                return NULL;
+                struct kernel_args32* args32 = &dev->args32[fractal];
+                pass_args32(ctx, args32);
+                set_subframe(ctx, frame, &args32->ofs_x, &args32->ofs_y);
+                if (set_kernel_arg(kernel, name, 2, sizeof(*args32), args32)) return 1;
+                ofs_x = args32->ofs_x;
+                ofs_y = args32->ofs_y;
             }
-            pthread_cond_wait(&t->cond, &t->lock);
+
+            err = clEnqueueNDRangeKernel(dev->queue, kernel, 2, ofs, gws, local_work_size(dev, fractal, gws), 0, NULL, NULL);
+            if (err != CL_SUCCESS)
+            {
+                printf("%s: clEnqueueNDRangeKernel %s returned %d\n", dev->name, name, err);
+                return 1;
+            }
+            subframes |= written_region(&ctx->view, start, end, ofs_x, ofs_y, &y1, &y2);
         }
-        t->work = 0;
-        pthread_mutex_unlock(&t->lock);
+        mark_dirty(buf, y1, y2, subframes);
+
+        // read only calculated sub-frames of tile directly to frame shared with CPU threads
+        if (read_tile(dev, buf, y1, y2, subframes, ctx->pixels)) return 1;
+        tile_done(ctx, BACKEND_OCL, gws[0] * gws[1] * ctx->view.draw_frames);
+    }
+    return 0;
+}
+
+void* ocl_kernel(void* d)
+{
+    struct ocl_device* dev = (struct ocl_device*)d;
+    struct ocl_thread* t = &dev->thread;
+    struct ocl_job job;
+    struct ocl_completion c;
+    int err = 0;
 
+    while (!err && !take_job(t, &job))
+    {
         //      printf("ocl kernel for %s tid=%lx\n", dev->name,
         //            dev->thread.tid);
 
-        err = execute_fractal(dev, fractal);
+        if (job.tiles)
+            err = execute_tiles(dev, job.ctx);
+        else
+            err = execute_fractal(dev, job.ctx);
 
         if (err)
         {
             printf("thread interrupted\n");
+            // device isn't usable anymore, it's skipped by scheduling and still closed at exit
             dev->thread.finished = 1;
-            nr_devices--;
         }
 
-        pthread_mutex_lock(&lock_fin);
-        tasks_finished++;
-        pthread_cond_signal(&cond_fin);
-        pthread_cond_broadcast(&cond_fin);
-        pthread_mutex_unlock(&lock_fin);
+        c.generation = job.generation;
+        c.err = err;
+        c.execution = job.tiles || frame_cancelled(job.ctx) ? 0 : dev->execution;
+        post_completion(t, &c);
     }
     if (!quiet) printf("%s: thread exits\n", dev->name);
     return NULL;
 }
 
-int signal_device(struct ocl_device* dev)
+int signal_device(struct ocl_device* dev, struct render_ctx* ctx, int tiles)
 {
+    struct ocl_job job;
+
     //	printf("signal current device: %s\n", dev->name);
     if (!dev->initialized) return 1;
     if (dev->thread.finished)
@@ -297,96 +584,347 @@ int signal_device(struct ocl_device* dev)
         return 1;
     }
 
-    pthread_mutex_lock(&dev->thread.lock);
-    dev->thread.work = 1;
-    pthread_cond_signal(&dev->thread.cond);
-    pthread_mutex_unlock(&dev->thread.lock);
+    job.ctx = ctx;
+    job.generation = ctx->view.generation;
+    job.tiles = tiles;
+    if (post_job(&dev->thread, &job))
+    {
+        printf("%s: too many jobs queued\n", dev->name);
+        return 1;
+    }
     return 0;
 }
 
-void start_ocl()
+int usable_device(struct ocl_device* dev) { return dev->initialized && !dev->thread.finished; }
+
+/* divide rows of global work size between devices proportionally to their
+   throughput measured in previous frames, every device gets at least one row
+   to keep its measurement up to date */
+int split_frame(struct render_ctx* ctx)
 {
-    if (!nr_devices) return;
+    int d, usable = 0, start = 0;
+    double total = 0.0;
+    int measured = 1;
 
-    if (signal_device(&ocl_devices[current_device]))
+    for (d = 0; d < nr_devices; d++)
     {
-        printf("can't signal device\n");
-        return;
+        struct ocl_device* dev = &ocl_devices[d];
+
+        // bands are shown by UI thread
+        __atomic_store_n(&dev->band_start, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&dev->band_end, 0, __ATOMIC_RELAXED);
+        if (!usable_device(dev)) continue;
+        usable++;
+        total += dev->pps;
+        if (!dev->pps) measured = 0;
     }
+    if (!usable) return 0;
+    if (usable > ctx->view.gws_y) usable = ctx->view.gws_y;
 
-    pthread_mutex_lock(&lock_fin);
-    //    printf("waiting for finished tasks\n");
-
-    //    unsigned long tp1, tp2;
-    //    tp1 = get_time_usec();
-    while (!tasks_finished)
+    for (d = 0; d < nr_devices && usable; d++)
     {
-        pthread_cond_wait(&cond_fin, &lock_fin);
+        struct ocl_device* dev = &ocl_devices[d];
+        int rows;
+
+        if (!usable_device(dev)) continue;
+        if (measured)
+            rows = roundf(ctx->view.gws_y * dev->pps / total);
+        else
+            rows = ctx->view.gws_y / usable;
+
+        if (rows < 1) rows = 1;
+        if (rows > ctx->view.gws_y - start - (usable - 1)) rows = ctx->view.gws_y - start - (usable - 1);
+        if (usable == 1) rows = ctx->view.gws_y - start; // last device takes the rest
+
+        __atomic_store_n(&dev->band_start, start, __ATOMIC_RELAXED);
+        __atomic_store_n(&dev->band_end, start + rows, __ATOMIC_RELAXED);
+        start += rows;
+        usable--;
     }
-    //    tp2 = get_time_usec();
-    //    printf("tasks finished %ld\n", tp2-tp1);
-    tasks_finished = 0;
-    pthread_mutex_unlock(&lock_fin);
+    return 1;
 }
 
-void update_gpu_texture(int postprocess)
+/* collect completions of jobs posted to selected device or to all devices in multi device mode,
+   returns number of collected completions, other devices can be driven by other threads */
+int wait_for_devices(struct view* v)
 {
-    int err;
-    if (ocl_devices[current_device].initialized)
+    int d, tasks = 0;
+
+    for (d = 0; d < nr_devices; d++)
     {
-        void* px1;
+        struct ocl_thread* t = &ocl_devices[d].thread;
 
-        px1 = clEnqueueMapBuffer(ocl_devices[current_device].queue, ocl_devices[current_device].cl_pixels, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, IMAGE_SIZE,
-                                 0, NULL, NULL, &err);
-        if (err != CL_SUCCESS)
+        if (!v->multi_device && d != v->device) continue;
+
+        while (t->pending)
         {
-            printf("clEnqueueMapBuffer error %d\n", err);
+            take_completion(t, &t->last);
+            tasks++;
         }
-        else
-        {
-            if (postprocess)
-            {
-                make_postprocess(px1);
-            }
-            else
-            {
-                memcpy(texture_pixels, px1, IMAGE_SIZE);
-            }
+    }
+    return tasks;
+}
+
+/* pixel buffers, band split and job ring of device are used by one context at a time, contexts sharing
+   devices lock selected device or all devices in multi device mode, always in the same order */
+void lock_ocl(struct view* v)
+{
+    int d;
+
+    for (d = 0; d < nr_devices; d++)
+        if (v->multi_device || d == v->device) pthread_mutex_lock(&ocl_devices[d].lock);
+}
+
+void unlock_ocl(struct view* v)
+{
+    int d;
 
-            if (fractal == DRAGON) memset(px1, 0, IMAGE_SIZE);
-            clEnqueueUnmapMemObject(ocl_devices[current_device].queue, ocl_devices[current_device].cl_pixels, px1, 0, NULL, NULL);
+    for (d = nr_devices - 1; d >= 0; d--)
+        if (v->multi_device || d == v->device) pthread_mutex_unlock(&ocl_devices[d].lock);
+}
+
+// buffer with last calculated frame
+struct ocl_buffer* previous_buffer(struct ocl_device* dev) { return &dev->buffers[(dev->calc + dev->nr_buffers - 1) % dev->nr_buffers]; }
+
+/* buffers of selected device or of all devices in multi device mode have size of frame of view,
+   they are reallocated only when frame isn't pipelined, so previous frame isn't read from them */
+int prepare_frame_ocl(struct view* v)
+{
+    int d;
+
+    for (d = 0; d < nr_devices; d++)
+    {
+        struct ocl_device* dev = &ocl_devices[d];
+
+        if (!usable_device(dev) || (!v->multi_device && d != v->device)) continue;
+        if (prepare_pixels(dev, v->width, v->height))
+        {
+            printf("%s: can't allocate buffers for %dx%d frame\n", dev->name, v->width, v->height);
+            release_pixels(dev);
+            return 1;
         }
     }
+    return 0;
+}
+
+/* signal selected device or all devices in multi device mode to calculate next frame
+   without waiting for them, returns number of signaled devices */
+int signal_ocl(struct render_ctx* ctx)
+{
+    int d, tasks = 0;
+
+    if (!nr_devices || prepare_frame_ocl(&ctx->view)) return 0;
+    ctx->ocl_start = get_time_usec();
+
+    if (!multi_frame(&ctx->view))
+    {
+        if (!signal_device(&ocl_devices[ctx->view.device], ctx, 0)) return 1;
+        printf("can't signal device\n");
+        return 0;
+    }
+
+    if (!split_frame(ctx)) return 0;
+    for (d = 0; d < nr_devices; d++)
+    {
+        struct ocl_device* dev = &ocl_devices[d];
+
+        if (dev->band_end == dev->band_start) continue;
+        if (!signal_device(dev, ctx, 0)) tasks++;
+    }
+    return tasks;
+}
+
+// wait for devices signaled by signal_ocl
+void finish_ocl(struct render_ctx* ctx, int tasks)
+{
+    if (!tasks) return;
+    wait_for_devices(&ctx->view);
+    if (frame_cancelled(ctx)) return;
+    if (multi_frame(&ctx->view))
+        ctx->ocl_execution = (get_time_usec() - ctx->ocl_start) / ctx->view.draw_frames;
+    else
+        ctx->ocl_execution = ocl_devices[ctx->view.device].thread.last.execution;
+}
+
+/* buffer with calculated frame becomes previous one and next frame is calculated in other buffer,
+   called when previous frame isn't read anymore */
+void swap_ocl_buffers(struct render_ctx* ctx)
+{
+    int d, multi = multi_frame(&ctx->view);
+
+    for (d = 0; d < nr_devices; d++)
+    {
+        struct ocl_device* dev = &ocl_devices[d];
+
+        if (!dev->initialized || (multi ? dev->band_end == dev->band_start : d != ctx->view.device)) continue;
+        dev->calc = (dev->calc + 1) % dev->nr_buffers;
+    }
+}
+
+void start_ocl(struct render_ctx* ctx)
+{
+    finish_ocl(ctx, signal_ocl(ctx));
+    swap_ocl_buffers(ctx);
+}
+
+/* next frame can be calculated while previous one is presented if all used devices have second buffer,
+   dragon is drawn in one buffer cleared after every frame */
+int pipelined_ocl(struct view* v)
+{
+    int d, multi = multi_frame(v);
+
+    if (v->fractal == DRAGON || !usable_device(&ocl_devices[v->device])) return 0;
+    for (d = 0; d < nr_devices; d++)
+    {
+        struct ocl_device* dev = &ocl_devices[d];
+
+        if (!usable_device(dev) || (!multi && d != v->device)) continue;
+        if (dev->nr_buffers < 2 || dev->width != v->width || dev->height != v->height) return 0;
+    }
+    return 1;
+}
+
+/* signal selected device or all devices in multi device mode to take tiles
+   from the queue, returns number of signaled devices */
+int start_tiles_ocl(struct render_ctx* ctx)
+{
+    int d, tasks = 0;
+
+    if (prepare_frame_ocl(&ctx->view)) return 0;
+    if (!ctx->view.multi_device) return signal_device(&ocl_devices[ctx->view.device], ctx, 1) ? 0 : 1;
+
+    for (d = 0; d < nr_devices; d++)
+    {
+        if (!usable_device(&ocl_devices[d])) continue;
+        if (!signal_device(&ocl_devices[d], ctx, 1)) tasks++;
+    }
+    return tasks;
+}
+
+/* pass rows [y1, y2) of frame calculated by zero copy device to copy_rows,
+   callback gets pointer to device memory with iterations or with colors */
+int copy_mapped_rows(struct ocl_device* dev, int y1, int y2, int argb, void (*copy_rows)(void*, int, int, void*), void* data)
+{
+    struct ocl_buffer* buf = &dev->buffers[0];
+    cl_mem pixels = argb ? buf->argb : buf->pixels;
+    size_t pitch = dev->width * BPP;
+    void* px1;
+    int err;
+
+    px1 = clEnqueueMapBuffer(dev->queue, pixels, CL_TRUE, CL_MAP_READ, y1 * pitch, (y2 - y1) * pitch, 0, NULL, NULL, &err);
+    if (err != CL_SUCCESS)
+    {
+        printf("%s: clEnqueueMapBuffer error %d\n", dev->name, err);
+        return 1;
+    }
+    buf->dirty_subframes = 0;
+    copy_rows(data, y1, y2, px1);
+    clEnqueueUnmapMemObject(dev->queue, pixels, px1, 0, NULL, NULL);
+    return 0;
+}
+
+/* read region of last calculated frame changed since previous read to host frame and pass these rows to copy_rows,
+   reads use own queue, so kernels of next frame can be running at the same time */
+int copy_staged_rows(struct ocl_device* dev, int argb, void (*copy_rows)(void*, int, int, void*), void* data)
+{
+    struct ocl_buffer* buf = previous_buffer(dev);
+    int y1 = buf->dirty_y1, y2 = buf->dirty_y2;
+
+    if (!buf->dirty_subframes) return 0;
+    if (read_region(dev, dev->read_queue, argb ? buf->argb : buf->pixels, y1, y2, buf->dirty_subframes, dev->frame)) return 1;
+    buf->dirty_subframes = 0;
+    copy_rows(data, y1, y2, (char*)dev->frame + y1 * dev->width * BPP);
+    return 0;
+}
+
+/* rows of last frame calculated by selected device or by all devices in multi device mode changed since
+   previous read are passed to copy_rows(data, y1, y2, rows), rows have FRAME_PITCH of view bytes,
+   they have colors if frame was colored on device */
+void read_frame_ocl(struct view* v, void (*copy_rows)(void*, int, int, void*), void* data)
+{
+    int d;
+    int rows_per_band = v->height / v->gws_y;
+    int multi = multi_frame(v);
+
+    for (d = 0; d < nr_devices; d++)
+    {
+        struct ocl_device* dev = &ocl_devices[d];
+
+        if (!usable_device(dev) || (!multi && d != v->device) || dev->width != v->width || dev->height != v->height) continue;
+        if (!dev->zero_copy)
+            copy_staged_rows(dev, v->device_color, copy_rows, data);
+        else if (!multi)
+            copy_mapped_rows(dev, 0, v->height, v->device_color, copy_rows, data);
+        else if (dev->band_end > dev->band_start)
+            copy_mapped_rows(dev, dev->band_start * rows_per_band, dev->band_end * rows_per_band, v->device_color, copy_rows, data);
+    }
+    if (v->fractal == DRAGON) clear_pixels_ocl(v->device);
 }
 
 int prepare_thread(struct ocl_device* dev)
 {
     if (!dev->initialized) return 0;
 
-    dev->thread.work = 0;
-    if (pthread_mutex_init(&dev->thread.lock, NULL)) return 1;
-    if (pthread_cond_init(&dev->thread.cond, NULL)) return 1;
+    if (start_rings(&dev->thread)) return 1;
     pthread_create(&dev->thread.tid, NULL, ocl_kernel, dev);
     return 0;
 }
 
-void clear_pixels_ocl()
+void clear_pixels_ocl(int device)
 {
-    if (ocl_devices && ocl_devices[current_device].initialized)
+    if (__atomic_load_n(&ocl_state, __ATOMIC_ACQUIRE) == OCL_READY && ocl_devices[device].initialized)
     {
-        void* px1;
-        int err;
+        struct ocl_device* dev = &ocl_devices[device];
+        cl_uint zero = 0;
+        int err, b;
 
-        px1 = clEnqueueMapBuffer(ocl_devices[current_device].queue, ocl_devices[current_device].cl_pixels, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, IMAGE_SIZE,
-                                 0, NULL, NULL, &err);
-        if (err != CL_SUCCESS)
-        {
-            printf("clEnqueueMapBuffer error %d\n", err);
-        }
-        else
+        for (b = 0; b < dev->nr_buffers; b++)
         {
-            memset(px1, 0, IMAGE_SIZE);
-            clEnqueueUnmapMemObject(ocl_devices[current_device].queue, ocl_devices[current_device].cl_pixels, px1, 0, NULL, NULL);
+            err = clEnqueueFillBuffer(dev->queue, dev->buffers[b].pixels, &zero, sizeof(zero), 0, (size_t)dev->width * dev->height * BPP, 0, NULL, NULL);
+            if (err != CL_SUCCESS)
+            {
+                printf("clEnqueueFillBuffer error %d\n", err);
+                return;
+            }
+            // host copy of frame has to be read again
+            mark_dirty(&dev->buffers[b], 0, dev->height, ALL_SUBFRAMES);
         }
+        clFinish(dev->queue);
+    }
+}
+
+int init_ocl_devices()
+{
+    int d;
+
+    __atomic_store_n(&ocl_state, OCL_INIT, __ATOMIC_RELEASE);
+    if (init_ocl()) goto failed;
+
+    for (d = 0; d < nr_devices; d++)
+    {
+        // pixel buffers are allocated with the first frame, when its size is known
+        if (prepare_colors(&ocl_devices[d])) goto failed;
+        if (prepare_thread(&ocl_devices[d])) goto failed;
     }
+    __atomic_store_n(&ocl_state, OCL_READY, __ATOMIC_RELEASE);
+    return 0;
+
+failed:
+    __atomic_store_n(&ocl_state, OCL_FAILED, __ATOMIC_RELEASE);
+    return 1;
+}
+
+void* init_ocl_thread(void* p)
+{
+    unsigned long tp1, tp2;
+
+    tp1 = get_time_usec();
+    if (init_ocl_devices())
+    {
+        printf("OpenCL device not found, using CPU only\n");
+        return NULL;
+    }
+    tp2 = get_time_usec();
+    if (!quiet) printf("OpenCL initialized in background in %lu [us]\n", tp2 - tp1);
+    return NULL;
 }
@@ -20,6 +20,9 @@
 #include "fractal_ocl.h"
 #endif
 
+int frame_width = DEFAULT_WIDTH; // size of frame shown in window, multiples of 4
+int frame_height = DEFAULT_HEIGHT;
+
 const char* font_file = "FreeMono.ttf";
 TTF_Font* font;
 
@@ -86,16 +89,17 @@ int init_window()
     SDL_Window* app_window;
     if (SDL_Init(SDL_INIT_VIDEO) < 0) return 1;
 #ifdef SDL_ACCELERATED
-    app_window = SDL_CreateWindow("FractalCL", SDL_WINDOWPOS_CENTERED | SDL_WINDOW_OPENGL, SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH, HEIGHT, 0);
+    app_window =
+        SDL_CreateWindow("FractalCL", SDL_WINDOWPOS_CENTERED | SDL_WINDOW_OPENGL, SDL_WINDOWPOS_CENTERED, frame_width + RIGTH_PANEL_WIDTH, frame_height, 0);
     main_window = SDL_CreateRenderer(app_window, -1, SDL_RENDERER_ACCELERATED);
 #else
-    app_window = SDL_CreateWindow("FractalCL", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH, HEIGHT, 0);
+    app_window = SDL_CreateWindow("FractalCL", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, frame_width + RIGTH_PANEL_WIDTH, frame_height, 0);
     main_window = SDL_CreateRenderer(app_window, -1, SDL_RENDERER_SOFTWARE);
 #endif
 
-    texture = SDL_CreateTexture(main_window, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, WIDTH, HEIGHT);
+    texture = SDL_CreateTexture(main_window, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, frame_width, frame_height);
     init_font();
-    draw_box(WIDTH, 0, RIGTH_PANEL_WIDTH, HEIGHT, 0, 0, 60);
+    draw_box(frame_width, 0, RIGTH_PANEL_WIDTH, frame_height, 0, 0, 60);
     return 0;
 }
 
@@ -110,46 +114,46 @@ void draw_box(int x, int y, int w, int h, int r, int g, int b)
     SDL_RenderFillRect(main_window, &dst);
 }
 
-void clear_window() { draw_box(0, 0, WIDTH, HEIGHT, 0, 0, 0); }
+void clear_window() { draw_box(0, 0, frame_width, frame_height, 0, 0, 0); }
 
 void draw_double(int y, char* txt, double val)
 {
     char buf[256];
     sprintf(buf, "%s=%2.10e  ", txt, val);
-    write_text(buf, WIDTH, FONT_SIZE * y + 2);
+    write_text(buf, frame_width, FONT_SIZE * y + 2);
 }
 
 void draw_int(int y, char* txt, int val)
 {
     char buf[256];
     sprintf(buf, "%s=%d  ", txt, val);
-    write_text(buf, WIDTH, FONT_SIZE * y + 2);
+    write_text(buf, frame_width, FONT_SIZE * y + 2);
 }
 
 void draw_long(int y, char* txt, unsigned long val)
 {
     char buf[256];
     sprintf(buf, "%s=%lu  ", txt, val);
-    write_text(buf, WIDTH, FONT_SIZE * y + 2);
+    write_text(buf, frame_width, FONT_SIZE * y + 2);
 }
 
 void draw_2long(int y, char* txt1, unsigned long val1, char* txt2, unsigned long val2)
 {
     char buf[256];
     sprintf(buf, "%s=%lu %s=%lu     ", txt1, val1, txt2, val2);
-    write_text(buf, WIDTH, FONT_SIZE * y + 2);
+    write_text(buf, frame_width, FONT_SIZE * y + 2);
 }
 
 void draw_hex(int y, char* txt, int val)
 {
     char buf[256];
     sprintf(buf, "%s=%-8x", txt, val);
-    write_text(buf, WIDTH, FONT_SIZE * y + 2);
+    write_text(buf, frame_width, FONT_SIZE * y + 2);
 }
 
 void draw_string(int y, char* txt, char* val)
 {
     char buf[256];
     sprintf(buf, "%s=%s", txt, val);
-    write_text(buf, WIDTH, FONT_SIZE * y + 2);
+    write_text(buf, frame_width, FONT_SIZE * y + 2);
 }
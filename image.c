@@ -0,0 +1,238 @@
+/*
+    Copyright (C) 2018-2019  Jacek Danecki <jacek.m.danecki@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "image.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// PNG is written without zlib, every row is one stored (not compressed) deflate block in own IDAT chunk
+#define STORED_BLOCK 65535
+#define ADLER_BLOCK 5552
+
+struct image_file
+{
+    FILE* f;
+    int format;
+    int width, height;
+    int rows;              // rows written so far
+    int row_size;          // bytes of RGB row, with filter type for PNG
+    unsigned char* row;    // RGB row
+    unsigned char* chunk;  // IDAT chunk of one row
+    uint32_t adler_a, adler_b;
+};
+
+static uint32_t crc_table[256];
+
+void init_crc_table()
+{
+    uint32_t c;
+    int n, k;
+
+    for (n = 0; n < 256; n++)
+    {
+        c = n;
+        for (k = 0; k < 8; k++) c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        crc_table[n] = c;
+    }
+}
+
+uint32_t update_crc(uint32_t crc, const unsigned char* buf, int len)
+{
+    int n;
+
+    for (n = 0; n < len; n++) crc = crc_table[(crc ^ buf[n]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+void put_be32(unsigned char* p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+int write_png_chunk(FILE* f, const char* type, const unsigned char* data, int len)
+{
+    unsigned char hdr[8], crc[4];
+    uint32_t c;
+
+    put_be32(hdr, len);
+    memcpy(hdr + 4, type, 4);
+    c = update_crc(0xffffffff, hdr + 4, 4);
+    c = update_crc(c, data, len);
+    put_be32(crc, c ^ 0xffffffff);
+    if (fwrite(hdr, 8, 1, f) != 1) return 1;
+    if (len && fwrite(data, len, 1, f) != 1) return 1;
+    if (fwrite(crc, 4, 1, f) != 1) return 1;
+    return 0;
+}
+
+int write_png_header(struct image_file* img)
+{
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    unsigned char ihdr[13];
+
+    put_be32(ihdr, img->width);
+    put_be32(ihdr + 4, img->height);
+    ihdr[8] = 8;  // bits per channel
+    ihdr[9] = 2;  // RGB
+    ihdr[10] = 0; // deflate
+    ihdr[11] = 0; // filter method
+    ihdr[12] = 0; // no interlace
+    if (fwrite(signature, 8, 1, img->f) != 1) return 1;
+    return write_png_chunk(img->f, "IHDR", ihdr, 13);
+}
+
+// row is split into stored blocks, first chunk starts zlib stream
+int write_png_row(struct image_file* img)
+{
+    unsigned char* p = img->chunk;
+    int ofs, len, i;
+
+    if (!img->rows)
+    {
+        *p++ = 0x78;
+        *p++ = 0x01;
+    }
+    for (ofs = 0; ofs < img->row_size; ofs += len)
+    {
+        len = img->row_size - ofs;
+        if (len > STORED_BLOCK) len = STORED_BLOCK;
+        *p++ = 0;
+        *p++ = len & 0xff;
+        *p++ = len >> 8;
+        *p++ = ~len & 0xff;
+        *p++ = (~len >> 8) & 0xff;
+        memcpy(p, img->row + ofs, len);
+        p += len;
+    }
+    // sums can't overflow within ADLER_BLOCK bytes, so modulo is taken once per block
+    for (ofs = 0; ofs < img->row_size; ofs += ADLER_BLOCK)
+    {
+        len = img->row_size - ofs < ADLER_BLOCK ? img->row_size - ofs : ADLER_BLOCK;
+        for (i = ofs; i < ofs + len; i++)
+        {
+            img->adler_a += img->row[i];
+            img->adler_b += img->adler_a;
+        }
+        img->adler_a %= 65521;
+        img->adler_b %= 65521;
+    }
+    return write_png_chunk(img->f, "IDAT", img->chunk, p - img->chunk);
+}
+
+// last empty block ends deflate stream, adler32 ends zlib stream
+int write_png_end(struct image_file* img)
+{
+    unsigned char end[9] = {1, 0, 0, 0xff, 0xff};
+
+    put_be32(end + 5, img->adler_b << 16 | img->adler_a);
+    if (write_png_chunk(img->f, "IDAT", end, 9)) return 1;
+    return write_png_chunk(img->f, "IEND", NULL, 0);
+}
+
+// format selected by extension of file, PPM is default
+int image_format(const char* path)
+{
+    const char* ext = strrchr(path, '.');
+
+    if (ext && !strcasecmp(ext, ".png")) return IMAGE_PNG;
+    return IMAGE_PPM;
+}
+
+struct image_file* create_image(const char* path, int width, int height)
+{
+    struct image_file* img;
+    int blocks;
+
+    if (width <= 0 || height <= 0) return NULL;
+    img = calloc(1, sizeof(*img));
+    if (!img) return NULL;
+    img->format = image_format(path);
+    img->width = width;
+    img->height = height;
+    img->row_size = 3 * width + (img->format == IMAGE_PNG);
+    img->adler_a = 1;
+    blocks = (img->row_size + STORED_BLOCK - 1) / STORED_BLOCK;
+    img->row = malloc(img->row_size);
+    img->chunk = malloc(img->row_size + 5 * blocks + 2);
+    img->f = fopen(path, "wb");
+    if (!img->row || !img->chunk || !img->f)
+    {
+        printf("can't create image %s\n", path);
+        goto err;
+    }
+    if (img->format == IMAGE_PNG)
+    {
+        init_crc_table();
+        if (write_png_header(img)) goto err;
+    }
+    else if (fprintf(img->f, "P6\n%d %d\n255\n", width, height) < 0)
+        goto err;
+    return img;
+err:
+    if (img->f) fclose(img->f);
+    free(img->chunk);
+    free(img->row);
+    free(img);
+    return NULL;
+}
+
+int write_image_rows(struct image_file* img, const void* rows, int nr_rows, int pitch)
+{
+    int x, y;
+
+    if (img->rows + nr_rows > img->height) return 1;
+    for (y = 0; y < nr_rows; y++)
+    {
+        const uint32_t* src = (const uint32_t*)((const char*)rows + (size_t)y * pitch);
+        unsigned char* p = img->row;
+
+        if (img->format == IMAGE_PNG) *p++ = 0; // no filter
+        for (x = 0; x < img->width; x++)
+        {
+            *p++ = src[x] >> 16;
+            *p++ = src[x] >> 8;
+            *p++ = src[x];
+        }
+        if (img->format == IMAGE_PNG)
+        {
+            if (write_png_row(img)) return 1;
+        }
+        else if (fwrite(img->row, img->row_size, 1, img->f) != 1)
+            return 1;
+        img->rows++;
+    }
+    return 0;
+}
+
+// returns 0 if all rows were written
+int close_image(struct image_file* img)
+{
+    int err = img->rows != img->height;
+
+    if (!err && img->format == IMAGE_PNG) err = write_png_end(img);
+    if (fclose(img->f)) err = 1;
+    free(img->chunk);
+    free(img->row);
+    free(img);
+    return err;
+}
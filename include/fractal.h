@@ -43,6 +43,26 @@ enum fractals
     NR_FRACTALS
 };
 
+enum backends
+{
+    BACKEND_CPU,
+    BACKEND_OCL,
+    NR_BACKENDS
+};
+
+#define TILE_ROWS 8 // rows of global work size in one tile shared by CPU and OCL devices
+#define PARTIAL_FRAME_TIME 100000 // [us] frame calculated on CPU is shown before it's finished
+
+extern volatile unsigned int generation; // generation of the newest view
+
+struct render_ctx;
+
+int frame_cancelled(struct render_ctx* ctx);
+int get_tile(struct render_ctx* ctx, int* start, int* end);
+void next_subframe(int* ofs_x, int* ofs_y);
+void set_subframe(struct render_ctx* ctx, int frame, int* ofs_x, int* ofs_y);
+void tile_done(struct render_ctx* ctx, enum backends b, int pixels);
+
 #include "common.h"
 
 #endif
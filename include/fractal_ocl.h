@@ -30,15 +30,58 @@ struct ocl_fractal
 extern struct ocl_fractal fractals[NR_FRACTALS];
 extern struct ocl_fractal test_fractal;
 
+#define RING_SIZE 4 // power of 2, more than jobs posted to device before waiting for them
+
+struct ocl_job
+{
+    struct render_ctx* ctx;  // context of frame
+    unsigned int generation; // view generation of frame
+    int tiles;               // take tiles from queue shared with CPU threads instead of calculating frame
+};
+
+// record of every job finished by device thread
+struct ocl_completion
+{
+    unsigned int generation;
+    int err;
+    unsigned long execution; // [us] time of one pass, 0 if frame was cancelled
+};
+
+/* single producer/single consumer rings, jobs are posted by render thread and taken by device thread,
+   completions go back the other way, consumer sleeps on eventfd only when its ring stays empty */
+struct ocl_ring
+{
+    unsigned int head, tail; // head is written only by consumer, tail only by producer
+    int sleeping;            // consumer waits on fd, producer has to wake it up
+    int fd;                  // eventfd
+};
+
 struct ocl_thread
 {
     pthread_t tid;
-    int work;
-    pthread_mutex_t lock;
-    pthread_cond_t cond;
+    struct ocl_ring job_ring;
+    struct ocl_job jobs[RING_SIZE];
+    struct ocl_ring done_ring;
+    struct ocl_completion done[RING_SIZE];
+    int pending;                 // jobs posted and not collected, used only by render thread
+    struct ocl_completion last; // last collected completion
     int finished;
 };
 
+#define PIPELINE_DEPTH 2
+#define QUEUED_PASSES 4   // kernel passes enqueued ahead, bounds latency of frame cancellation
+
+struct view;
+
+// pixel buffer and region written to it by kernels since it was read last time
+struct ocl_buffer
+{
+    cl_mem pixels;
+    cl_mem argb; // colors of pixels written by color kernel, read instead of pixels when frame is colored on device
+    int dirty_y1, dirty_y2;       // rows written by kernels and not read yet
+    unsigned int dirty_subframes; // bit (ofs_y * 4 + ofs_x) for every sub-frame written and not read yet
+};
+
 struct ocl_device
 {
     cl_device_id device_id;
@@ -50,6 +93,7 @@ struct ocl_device
     cl_program program;
     cl_kernel kernels[NR_FRACTALS];
     cl_kernel test_kernel;
+    cl_kernel color_kernel;
 #ifdef FP_64_SUPPORT
     struct kernel_args64 args64[NR_FRACTALS];
 #endif
@@ -64,26 +108,83 @@ struct ocl_device
     unsigned int eu;
     size_t wgs;
     struct ocl_thread thread;
+    pthread_mutex_t lock; // held by thread rendering context on device, from signal until frame is read
     cl_mem cl_colors;
-    cl_mem cl_pixels;
+    cl_mem cl_palette;               // palette table of color kernel, uploaded when palette changes
+    struct KERNEL_ARGS palette_args; // palette of cl_palette
+    struct ocl_buffer buffers[PIPELINE_DEPTH]; // next frame is calculated while previous one is read
+    int nr_buffers;                            // 1 on zero copy devices, they can't overlap calculations with reads
+    int calc;                                  // buffer used by kernels, previous one holds last calculated frame
+    cl_command_queue read_queue;               // reads of previous frame don't wait for kernels in queue
+    void* host_pixels;                         // memory used by pixel buffer on devices with zero copy support
+    void* host_argb;                           // memory used by colors on devices with zero copy support
+    int zero_copy;     // device shares memory with host
+    int compact;       // kernels built with COMPACT_LAYOUT, sub-frames stored in separate blocks
+    cl_mem cl_staging; // pinned host memory used for reads from devices without zero copy
+    void* staging;     // cl_staging mapped once, same layout as pixel buffers
+    void* frame;       // host copy of frame in screen layout, de-interleaved from staging in compact layout
+    int width, height; // size of frame in pixel buffers, 0 - not allocated yet
     unsigned long execution;
+    int band_start, band_end; // rows of global work size calculated in multi device mode
+    double pps;               // measured pixels per second
+    size_t lws[NR_FRACTALS][2]; // local work size from tuning database, 0 - selected by driver
+    char options[256];          // build options from tuning database
     int intel;
     int fp64;
     int pocl;
 };
 
+#define ALL_SUBFRAMES 0xffff
+
+/* ocl_state and nr_devices are written by initialization thread with __ATOMIC_RELEASE stores and read by other
+   threads with __ATOMIC_ACQUIRE loads, so devices published before OCL_READY are seen by threads which see OCL_READY */
+enum ocl_states
+{
+    OCL_INIT,   // initialization in progress, platforms are enumerated and kernels compiled
+    OCL_READY,  // all devices can be used
+    OCL_FAILED, // OpenCL can't be used, only CPU is available
+};
+
 extern struct ocl_device* ocl_devices;
 extern int current_device;
-extern volatile int nr_devices;
+extern int nr_devices;
 extern int finish_thread;
+extern enum ocl_states ocl_state;
+extern volatile int ocl_steps, ocl_steps_done;
+extern int multi_device;
 
 int init_ocl();
+int create_kernels(struct ocl_device* devs, int n, char* options);
+int platform_devices(int first);
+char* platform_options(int first, int n);
+void release_kernels(struct ocl_device* dev);
+void tuning_file_name(char* name, int size);
+int load_tuning();
+int init_ocl_devices();
+void* init_ocl_thread(void* p);
 int close_ocl();
 int prepare_colors(struct ocl_device* dev);
-int prepare_pixels(struct ocl_device* dev);
+int prepare_pixels(struct ocl_device* dev, int width, int height);
+void release_pixels(struct ocl_device* dev);
+int prepare_frame_ocl(struct view* v);
 int prepare_thread(struct ocl_device* dev);
-void start_ocl();
-void clear_pixels_ocl();
-void update_gpu_texture();
+int start_rings(struct ocl_thread* t);
+int post_job(struct ocl_thread* t, struct ocl_job* job);
+int take_job(struct ocl_thread* t, struct ocl_job* job);
+void post_completion(struct ocl_thread* t, struct ocl_completion* c);
+void take_completion(struct ocl_thread* t, struct ocl_completion* c);
+void stop_thread(struct ocl_thread* t);
+void start_ocl(struct render_ctx* ctx);
+int signal_ocl(struct render_ctx* ctx);
+void finish_ocl(struct render_ctx* ctx, int tasks);
+void swap_ocl_buffers(struct render_ctx* ctx);
+int pipelined_ocl(struct view* v);
+int execute_fractal(struct ocl_device* dev, struct render_ctx* ctx);
+int start_tiles_ocl(struct render_ctx* ctx);
+int wait_for_devices(struct view* v);
+void lock_ocl(struct view* v);
+void unlock_ocl(struct view* v);
+void clear_pixels_ocl(int device);
+void read_frame_ocl(struct view* v, void (*copy_rows)(void*, int, int, void*), void* data);
 void show_ocl_devices();
 void show_ocl_device(int d);
@@ -22,6 +22,7 @@
 #include "common.h"
 #include "window.h"
 
+extern int frame_width, frame_height;
 extern SDL_Renderer* main_window;
 extern SDL_Texture* texture;
 extern void* texture_pixels;
@@ -0,0 +1,37 @@
+/*
+    Copyright (C) 2018-2019  Jacek Danecki <jacek.m.danecki@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _IMAGE_H_
+#define _IMAGE_H_
+
+/* PPM and PNG files written row by row, pixels are 0xAARRGGBB like in frames,
+   whole image never has to be kept in memory */
+
+enum image_formats
+{
+    IMAGE_PPM,
+    IMAGE_PNG,
+};
+
+struct image_file;
+
+int image_format(const char* path);
+struct image_file* create_image(const char* path, int width, int height);
+int write_image_rows(struct image_file* img, const void* rows, int nr_rows, int pitch);
+int close_image(struct image_file* img);
+
+#endif
@@ -0,0 +1,80 @@
+/*
+    Copyright (C) 2018-2019  Jacek Danecki <jacek.m.danecki@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _ITERFILE_H_
+#define _ITERFILE_H_
+
+#include <stdint.h>
+
+/* Iteration file (.fci) keeps numbers of iterations instead of colors, so rendered image
+   can be colored again and browsed without calculation. Layout (little endian):
+
+   struct fci_header
+   uint64_t offsets[]     - offsets of tiles in file, 0 if tile is missing, tiles of level 0
+                            by rows, then tiles of level 1, ...
+   tiles                  - tile_size x tile_size uint32_t iterations by rows, aligned to page,
+                            pixels of partial tiles outside of level are 0
+
+   Level n has ceil(width / 2^n) x ceil(height / 2^n) pixels, its pixel (x, y) is pixel
+   (x * 2^n, y * 2^n) of level 0, so every level keeps exact iterations of its points.
+   Levels are added until whole level fits in one tile. Files are mapped by readers,
+   so big images can be browsed without reading whole file. */
+
+#define FCI_MAGIC "FCLITER"
+#define FCI_VERSION 2
+#define FCI_TILE 256
+#define FCI_MAX_LEVELS 24
+
+// flags
+#define FCI_FP64 1 // calculated in double precision
+
+struct fci_header
+{
+    char magic[8];          // FCI_MAGIC
+    uint32_t version;       // FCI_VERSION
+    uint32_t header_size;   // offsets of tiles start after header
+    uint32_t width, height; // pixels of level 0
+    uint32_t tile_size;
+    uint32_t levels;
+    uint32_t flags;
+    int32_t fractal;
+    double x1, x2;          // pixel x of level 0 is point x1 + x * (x2 - x1) / width
+    double y1, y2;          // pixel y of level 0 is point y1 + y * (y2 - y1) / height
+    double c_x, c_y;        // constant of julia sets
+    double er;              // escape radius
+    uint32_t max_iter;
+    int32_t mod1;           // alternative formula of burning ship
+};
+
+struct iter_file;
+struct render_ctx;
+struct view;
+
+// writer, rows of level 0 are written in order and upper levels are built when file is closed
+struct iter_file* create_iter_file(const char* path, const struct fci_header* h);
+int write_iter_rows(struct iter_file* f, const void* rows, int nr_rows, int pitch);
+int close_iter_file(struct iter_file* f);
+
+// reader
+struct iter_file* open_iter_file(const char* path);
+const struct fci_header* iter_file_header(struct iter_file* f);
+void iter_level_size(struct iter_file* f, int level, int* width, int* height);
+const uint32_t* iter_tile(struct iter_file* f, int level, int tx, int ty);
+int stored_view(struct iter_file* f, struct view* v);
+void calculate_stored_frame(struct render_ctx* ctx, struct iter_file* f);
+
+#endif
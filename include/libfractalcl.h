@@ -0,0 +1,73 @@
+/*
+    Copyright (C) 2018-2019  Jacek Danecki <jacek.m.danecki@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _LIBFRACTALCL_H_
+#define _LIBFRACTALCL_H_
+
+/* render library of FractalCL, frames are calculated on CPU or OpenCL device
+   and copied to buffer of caller, it doesn't need window, SDL or TTF */
+
+#define FCL_DEVICE_CPU -1
+
+// same order as F1-F8 keys in window
+enum fcl_fractals
+{
+    FCL_JULIA,
+    FCL_MANDELBROT,
+    FCL_JULIA_FULL,
+    FCL_DRAGON,
+    FCL_JULIA3,
+    FCL_BURNING_SHIP,
+    FCL_GENERALIZED_CELTIC,
+    FCL_TRICORN,
+};
+
+struct fcl_view
+{
+    int fractal;
+    double x1, x2;       // left and right bound of complex plane
+    double y1, y2;       // top and bottom bound
+    double c_x, c_y;     // constant of julia sets
+    double er;           // escape radius
+    unsigned int max_iter;
+    int pal;             // 0 - hsv, 1, 2 - rgb
+    unsigned int rgb;    // color mask of hsv palette
+    unsigned int mm;     // multiplier of hsv palette
+    int mod1;            // alternative coloring
+    int postprocess;     // color by number of iterations
+    float c1[3], c2[3], c3[3], c4[3]; // rgb palette
+    int equalize;        // spread colors of palette by histogram of image
+};
+
+struct fcl_context;
+
+int fcl_init(int opencl);
+void fcl_shutdown();
+int fcl_devices();
+void fcl_default_view(int fractal, struct fcl_view* v);
+struct fcl_context* fcl_create(int device, int width, int height);
+void fcl_destroy(struct fcl_context* c);
+int fcl_set_size(struct fcl_context* c, int width, int height);
+int fcl_set_view(struct fcl_context* c, const struct fcl_view* v);
+int fcl_render(struct fcl_context* c, void* buffer, int pitch);
+int fcl_render_iterations(struct fcl_context* c, unsigned int* buffer, int pitch);
+int fcl_color(struct fcl_context* c, void* buffer, int pitch);
+unsigned int fcl_iterations(struct fcl_context* c, int x, int y);
+unsigned long fcl_render_time(struct fcl_context* c);
+int fcl_fp64(struct fcl_context* c);
+
+#endif
@@ -17,6 +17,6 @@
 
 extern unsigned int* colors;
 
-void show_palette();
 int initialize_colors();
-void make_postprocess(void* px1);
+unsigned int get_color(int c);
+unsigned int postprocess_color(unsigned int i, unsigned int max_iter);
@@ -14,11 +14,13 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
-#include "fractal.h"
+#include "render.h"
 
 #define OFS_LX -1.5f
 #define OFS_RX 1.5f
 
+extern struct render_ctx window_ctx; // context shown in window, owned by render thread
+
 extern FP_TYPE ofs_lx;
 extern FP_TYPE ofs_rx;
 extern FP_TYPE ofs_ty;
@@ -50,7 +52,6 @@ extern unsigned long prepare_time;
 extern unsigned long prepare_times;
 extern unsigned long flips;
 extern unsigned long frames_time;
-extern unsigned long cpu_execution;
 extern unsigned long cpu_executions, gpu_executions;
 extern unsigned long cpu_iter, gpu_iter;
 extern int color_channel;
@@ -62,6 +63,8 @@ extern int mod1;
 extern int postprocess;
 
 int calculate_offsets();
+void update_bounds();
+void snapshot_view(struct view* v);
 void select_fractal(int f);
 void select_fractals(int k);
 void clear_counters();
@@ -0,0 +1,104 @@
+/*
+    Copyright (C) 2018-2019  Jacek Danecki <jacek.m.danecki@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _RENDER_H_
+#define _RENDER_H_
+
+#include "fractal.h"
+#include "fractal_types.h"
+#include "window.h"
+
+// bytes of one row and of whole frame of view
+#define FRAME_PITCH(v) ((v)->width * BPP)
+#define FRAME_SIZE(v) ((size_t)(v)->width * (v)->height * BPP)
+
+#define PALETTE_MAX_COLORS (1 << 22) // views with more iterations are colored without palette table
+
+// colors of all numbers of iterations [0, max_iter] of palette or postprocess mode, built again when they change
+struct palette_table
+{
+    struct KERNEL_ARGS args; // palette of table
+    unsigned int* colors;
+    unsigned int size;
+};
+
+// immutable description of one frame, taken by UI thread and calculated by render thread
+struct view
+{
+    FP_TYPE ofs_lx, ofs_rx, ofs_ty, ofs_by;
+    FP_TYPE dx, dy;
+    FP_TYPE szx, szy;
+    FP_TYPE er;
+    FP_TYPE c_x, c_y;
+    unsigned int rgb, mm;
+    unsigned int max_iter;
+    int pal;
+    int mod1;
+    int postprocess;
+    float c1[3], c2[3], c3[3], c4[3];
+    enum fractals fractal;
+    int width, height; // size of frame in pixels, multiples of 4
+    int gws_x, gws_y;
+    int draw_frames;
+    int cur_dev;      // 0 - CPU, 1 - OCL
+    int device;       // selected OCL device
+    int multi_device; // frame split between all OCL devices
+    int hybrid;       // tiles shared by CPU and OCL
+    unsigned int generation; // newer view cancels calculation of this one
+    int stored;       // frame filled on CPU from iteration file, only missing pixels are calculated
+    int stored_level; // level of iteration file used for frame
+    int device_color; // frame calculated by OCL devices is colored there, host reads colors instead of iterations
+    int equalize;     // colors of palette spread by histogram of frame
+    struct KERNEL_ARGS args;     // kernel arguments derived once by view_kernel_args, passes set only ofs_x/ofs_y
+    struct kernel_args32 args32; // arguments for OCL devices without fp64
+};
+
+/* state of one rendered view, CPU backend can calculate several contexts at the same time,
+   OCL devices take jobs of any context, but contexts sharing device are serialized by lock_ocl */
+struct render_ctx
+{
+    struct view view;                  // frame being calculated, owned by thread rendering this context
+    void* pixels;                      // iterations of frame calculated on CPU and tiles read from OCL devices, FRAME_SIZE of view
+    unsigned int* colors;              // palette used by CPU backend
+    struct palette_table palette;      // palette table used by color_rows for frames of this context
+    volatile unsigned int* generation; // generation of the newest view, frame is cancelled when it's newer, NULL - never
+    int cpu_ofs_x, cpu_ofs_y;          // sub-frame calculated by last CPU pass
+    int nr_tiles;                      // tiles in current frame
+    volatile int next_tile;            // first tile not taken yet
+    int tile_phase;                    // sub-frame calculated by the first pass of the frame
+    unsigned long tile_pixels[NR_BACKENDS];
+    unsigned long backend_pps[NR_BACKENDS]; // throughput of CPU and OCL in the last frame
+    unsigned long cpu_execution;            // time of last frame on CPU
+    unsigned long ocl_execution;            // time of one pass on selected device(s)
+    unsigned long ocl_start;                // time when devices were signaled to calculate frame
+};
+
+extern int quiet;
+
+void kernel_args_from_view(struct view* v, struct KERNEL_ARGS* args);
+void view_kernel_args(struct view* v);
+unsigned int calculate_pixel(struct render_ctx* ctx, enum fractals f, struct KERNEL_ARGS* args, int x, int y);
+void start_cpu(struct render_ctx* ctx);
+int use_hybrid(struct view* v);
+void calculate_frame(struct render_ctx* ctx);
+int same_palette(const struct KERNEL_ARGS* a, const struct KERNEL_ARGS* b);
+void build_palette(struct KERNEL_ARGS* a, unsigned int* table);
+int histogram_rows(const void* src, int src_pitch, int width, int nr_rows, unsigned int* hist, unsigned int bins);
+void color_rows(struct palette_table* pt, struct view* v, const void* src, int src_pitch, void* dst, int dst_pitch, int width, int nr_rows);
+void release_palette_table(struct palette_table* pt);
+
+#endif
@@ -16,12 +16,8 @@
 */
 
 #define FONT_SIZE 20
-#define WIDTH 1024
+// size of frame is selected at runtime, these are defaults of window and render contexts
+#define DEFAULT_WIDTH 1024
+#define DEFAULT_HEIGHT 768
 #define RIGTH_PANEL_WIDTH 300
-#define WINDOW_WIDTH (WIDTH + RIGTH_PANEL_WIDTH)
-#define HEIGHT 768
-#define WIDTH_FL (WIDTH * 1.0f)
-#define HEIGHT_FL (HEIGHT * 1.0f)
 #define BPP 4
-#define PITCH (WIDTH * BPP)
-#define IMAGE_SIZE (WIDTH * HEIGHT * BPP)
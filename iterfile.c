@@ -0,0 +1,373 @@
+/*
+    Copyright (C) 2018-2019  Jacek Danecki <jacek.m.danecki@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "iterfile.h"
+#include "render.h"
+#include "timer.h"
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PAGE_SIZE 4096
+#define STORED_THREADS 16
+
+// file is mapped by writer and by readers, tiles are accessed directly in mapping
+struct iter_file
+{
+    int fd;
+    int writable;
+    char* map;
+    size_t size;
+    struct fci_header* hdr;
+    uint64_t* offsets;
+    size_t tile_bytes;
+    size_t data;                    // offset of first tile
+    int first_tile[FCI_MAX_LEVELS]; // index of first tile of level in offsets
+    int tiles_x[FCI_MAX_LEVELS], tiles_y[FCI_MAX_LEVELS];
+    int rows;                       // rows of level 0 written so far
+};
+
+// rows of frame filled by one thread
+struct stored_rows
+{
+    struct render_ctx* ctx;
+    struct iter_file* f;
+    const int* kx; // column of level for every column of frame, -1 outside of image
+    int ys, ye;
+};
+
+void iter_level_size(struct iter_file* f, int level, int* width, int* height)
+{
+    *width = (((uint64_t)f->hdr->width - 1) >> level) + 1;
+    *height = (((uint64_t)f->hdr->height - 1) >> level) + 1;
+}
+
+// tiles of every level, returns number of all tiles
+int iter_layout(struct iter_file* f)
+{
+    int l, w, h, tiles = 0;
+
+    for (l = 0; l < f->hdr->levels; l++)
+    {
+        iter_level_size(f, l, &w, &h);
+        f->tiles_x[l] = (w + f->hdr->tile_size - 1) / f->hdr->tile_size;
+        f->tiles_y[l] = (h + f->hdr->tile_size - 1) / f->hdr->tile_size;
+        f->first_tile[l] = tiles;
+        tiles += f->tiles_x[l] * f->tiles_y[l];
+    }
+    f->tile_bytes = (size_t)f->hdr->tile_size * f->hdr->tile_size * sizeof(uint32_t);
+    f->data = (f->hdr->header_size + tiles * sizeof(uint64_t) + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    return tiles;
+}
+
+// place of tile in file of writer, used before tile is marked as present
+uint32_t* tile_slot(struct iter_file* f, int level, int tx, int ty)
+{
+    return (uint32_t*)(f->map + f->data + (f->first_tile[level] + (size_t)ty * f->tiles_x[level] + tx) * f->tile_bytes);
+}
+
+void tile_written(struct iter_file* f, int level, int tx, int ty)
+{
+    f->offsets[f->first_tile[level] + ty * f->tiles_x[level] + tx] = (char*)tile_slot(f, level, tx, ty) - f->map;
+}
+
+// tile of level, NULL if it's missing
+const uint32_t* iter_tile(struct iter_file* f, int level, int tx, int ty)
+{
+    uint64_t o;
+
+    if (level < 0 || level >= f->hdr->levels || tx < 0 || ty < 0 || tx >= f->tiles_x[level] || ty >= f->tiles_y[level]) return NULL;
+    o = f->offsets[f->first_tile[level] + ty * f->tiles_x[level] + tx];
+    if (!o || (o & 3) || o > f->size || f->size - o < f->tile_bytes) return NULL;
+    return (const uint32_t*)(f->map + o);
+}
+
+const struct fci_header* iter_file_header(struct iter_file* f) { return f->hdr; }
+
+int map_iter_file(struct iter_file* f, int prot)
+{
+    f->map = mmap(NULL, f->size, prot, MAP_SHARED, f->fd, 0);
+    if (f->map == MAP_FAILED)
+    {
+        f->map = NULL;
+        return 1;
+    }
+    f->hdr = (struct fci_header*)f->map;
+    return 0;
+}
+
+void free_iter_file(struct iter_file* f)
+{
+    if (f->map) munmap(f->map, f->size);
+    if (f->fd >= 0) close(f->fd);
+    free(f);
+}
+
+/* file of whole image is created with holes, tiles are allocated by file system when
+   they are written, so memory and disk usage follows rendered bands */
+struct iter_file* create_iter_file(const char* path, const struct fci_header* h)
+{
+    struct iter_file* f;
+    struct fci_header hdr = *h;
+    int tiles;
+
+    if (!h->width || !h->height) return NULL;
+    memcpy(hdr.magic, FCI_MAGIC, sizeof(hdr.magic));
+    hdr.version = FCI_VERSION;
+    hdr.header_size = sizeof(hdr);
+    hdr.tile_size = FCI_TILE;
+    for (hdr.levels = 1; hdr.levels < FCI_MAX_LEVELS; hdr.levels++)
+        if (((hdr.width - 1) >> (hdr.levels - 1)) < FCI_TILE && ((hdr.height - 1) >> (hdr.levels - 1)) < FCI_TILE) break;
+
+    f = calloc(1, sizeof(*f));
+    if (!f) return NULL;
+    f->writable = 1;
+    f->hdr = &hdr;
+    tiles = iter_layout(f);
+    f->size = f->data + tiles * f->tile_bytes;
+    f->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (f->fd < 0 || ftruncate(f->fd, f->size) || map_iter_file(f, PROT_READ | PROT_WRITE))
+    {
+        printf("can't create iteration file %s\n", path);
+        free_iter_file(f);
+        return NULL;
+    }
+    memcpy(f->hdr, &hdr, sizeof(hdr));
+    f->offsets = (uint64_t*)(f->map + hdr.header_size);
+    return f;
+}
+
+// rows of width iterations, tiles of level 0 are present when their last row is written
+int write_iter_rows(struct iter_file* f, const void* rows, int nr_rows, int pitch)
+{
+    int ts = f->hdr->tile_size, tx, y, ty, w;
+
+    if (!f->writable || f->rows + nr_rows > f->hdr->height) return 1;
+    for (y = 0; y < nr_rows; y++, f->rows++)
+    {
+        const uint32_t* src = (const uint32_t*)((const char*)rows + (size_t)y * pitch);
+
+        ty = f->rows / ts;
+        for (tx = 0; tx < f->tiles_x[0]; tx++)
+        {
+            w = f->hdr->width - tx * ts < ts ? f->hdr->width - tx * ts : ts;
+            memcpy(tile_slot(f, 0, tx, ty) + (f->rows % ts) * ts, src + tx * ts, w * sizeof(uint32_t));
+        }
+        if (f->rows % ts == ts - 1 || f->rows == f->hdr->height - 1)
+            for (tx = 0; tx < f->tiles_x[0]; tx++) tile_written(f, 0, tx, ty);
+    }
+    return 0;
+}
+
+// every pixel of level is taken from even pixel of lower level, tile is built if its source tiles are present
+void build_level(struct iter_file* f, int level)
+{
+    int ts = f->hdr->tile_size, tx, ty, x, y, w, h;
+
+    iter_level_size(f, level, &w, &h);
+    for (ty = 0; ty < f->tiles_y[level]; ty++)
+    {
+        for (tx = 0; tx < f->tiles_x[level]; tx++)
+        {
+            uint32_t* dst = tile_slot(f, level, tx, ty);
+            int missing = 0;
+
+            for (y = 0; y < ts && ty * ts + y < h && !missing; y++)
+            {
+                int sy = 2 * (ty * ts + y), stx = -1;
+                const uint32_t* src = NULL;
+
+                for (x = 0; x < ts && tx * ts + x < w; x++)
+                {
+                    int sx = 2 * (tx * ts + x);
+
+                    if (sx / ts != stx)
+                    {
+                        stx = sx / ts;
+                        src = iter_tile(f, level - 1, stx, sy / ts);
+                    }
+                    if (!src)
+                    {
+                        missing = 1;
+                        break;
+                    }
+                    dst[y * ts + x] = src[(sy % ts) * ts + sx % ts];
+                }
+            }
+            if (!missing) tile_written(f, level, tx, ty);
+        }
+    }
+}
+
+// returns 0 if all rows were written and file was saved
+int close_iter_file(struct iter_file* f)
+{
+    int err = 0, l;
+
+    if (f->writable)
+    {
+        err = f->rows != f->hdr->height;
+        for (l = 1; l < f->hdr->levels && !err; l++) build_level(f, l);
+        if (msync(f->map, f->size, MS_SYNC)) err = 1;
+    }
+    free_iter_file(f);
+    return err;
+}
+
+struct iter_file* open_iter_file(const char* path)
+{
+    struct iter_file* f = calloc(1, sizeof(*f));
+    struct stat st;
+    int tiles;
+
+    if (!f) return NULL;
+    f->fd = open(path, O_RDONLY);
+    if (f->fd < 0 || fstat(f->fd, &st) || (size_t)st.st_size < sizeof(struct fci_header))
+    {
+        printf("can't open iteration file %s\n", path);
+        goto err;
+    }
+    f->size = st.st_size;
+    if (map_iter_file(f, PROT_READ)) goto err;
+    if (memcmp(f->hdr->magic, FCI_MAGIC, sizeof(f->hdr->magic)) || f->hdr->version != FCI_VERSION || f->hdr->header_size < sizeof(struct fci_header) ||
+        !f->hdr->width || !f->hdr->height || !f->hdr->tile_size || f->hdr->tile_size > 4096 || !f->hdr->levels || f->hdr->levels > FCI_MAX_LEVELS ||
+        f->hdr->fractal < 0 || f->hdr->fractal >= NR_FRACTALS || !f->hdr->max_iter || (f->hdr->header_size & 7))
+    {
+        printf("wrong iteration file %s\n", path);
+        goto err;
+    }
+    tiles = iter_layout(f);
+    if (f->hdr->header_size + tiles * sizeof(uint64_t) > f->size)
+    {
+        printf("iteration file %s is truncated\n", path);
+        goto err;
+    }
+    f->offsets = (uint64_t*)(f->map + f->hdr->header_size);
+    return f;
+err:
+    free_iter_file(f);
+    return NULL;
+}
+
+/* frame can be filled from file if it shows the same fractal and stored points aren't
+   sparser than its pixels, level with the biggest step not bigger than step of frame is used */
+int stored_view(struct iter_file* f, struct view* v)
+{
+    const struct fci_header* h = f->hdr;
+    double fx = fabs((h->x2 - h->x1) / h->width), fy = fabs((h->y2 - h->y1) / h->height);
+    double sx = fabs(v->args.step_x), sy = fabs(v->args.step_y);
+    double lx = v->args.ofs_lx, rx = lx + v->args.step_x * v->width;
+    double ty = v->args.ofs_ty, by = ty + v->args.step_y * v->height;
+    int julia = v->fractal == JULIA || v->fractal == JULIA3 || v->fractal == JULIA_FULL;
+    int l = 0;
+
+    v->stored = 0;
+    if (v->fractal != h->fractal || v->fractal == DRAGON || v->max_iter != h->max_iter || v->er != (FP_TYPE)h->er) return 0;
+    if (julia && (v->c_x != (FP_TYPE)h->c_x || v->c_y != (FP_TYPE)h->c_y)) return 0;
+    if (v->fractal == BURNING_SHIP && v->mod1 != h->mod1) return 0;
+    if (sx < fx * 0.999 || sy < fy * 0.999) return 0;
+    if (fmax(lx, rx) < fmin(h->x1, h->x2) || fmin(lx, rx) > fmax(h->x1, h->x2)) return 0;
+    if (fmax(ty, by) < fmin(h->y1, h->y2) || fmin(ty, by) > fmax(h->y1, h->y2)) return 0;
+
+    while (l + 1 < h->levels && fx * (2 << l) <= sx * 1.001 && fy * (2 << l) <= sy * 1.001) l++;
+    v->stored = 1;
+    v->stored_level = l;
+    v->device_color = 0;
+    return 1;
+}
+
+// nearest pixel of level for point p, -1 outside of level
+int level_pixel(double p, double p1, double step, int size)
+{
+    double k = floor((p - p1) / step + 0.5);
+
+    return k < 0 || k >= size ? -1 : (int)k;
+}
+
+void* fill_stored_rows(void* p)
+{
+    struct stored_rows* s = p;
+    struct render_ctx* ctx = s->ctx;
+    struct KERNEL_ARGS args = ctx->view.args;
+    const struct fci_header* h = s->f->hdr;
+    int level = ctx->view.stored_level, ts = h->tile_size;
+    int full = ctx->view.gws_x == ctx->view.width;
+    int x, y, ky, w, lh;
+    unsigned int* pixels = ctx->pixels;
+
+    iter_level_size(s->f, level, &w, &lh);
+    for (y = s->ys; y < s->ye && !frame_cancelled(ctx); y++)
+    {
+        ky = level_pixel(args.ofs_ty + y * args.step_y, h->y1, (h->y2 - h->y1) / h->height * (1 << level), lh);
+        for (x = 0; x < ctx->view.width; x++)
+        {
+            const uint32_t* tile = ky < 0 || s->kx[x] < 0 ? NULL : iter_tile(s->f, level, s->kx[x] / ts, ky / ts);
+
+            if (tile)
+            {
+                pixels[PIXEL_INDEX(args, x, y)] = tile[(ky % ts) * ts + s->kx[x] % ts];
+            }
+            else if (full)
+            {
+                calculate_pixel(ctx, ctx->view.fractal, &args, x, y);
+            }
+            else
+            {
+                args.ofs_x = x & 3;
+                args.ofs_y = y & 3;
+                calculate_pixel(ctx, ctx->view.fractal, &args, x >> 2, y >> 2);
+            }
+        }
+    }
+    return NULL;
+}
+
+/* frame accepted by stored_view is filled with iterations of file,
+   pixels of missing tiles and outside of image are calculated on CPU */
+void calculate_stored_frame(struct render_ctx* ctx, struct iter_file* f)
+{
+    const struct fci_header* h = f->hdr;
+    struct stored_rows rows[STORED_THREADS];
+    pthread_t tid[STORED_THREADS];
+    unsigned long tp1 = get_time_usec();
+    int* kx = malloc(ctx->view.width * sizeof(int));
+    int level = ctx->view.stored_level, x, t, w, lh;
+
+    if (!kx) return;
+    iter_level_size(f, level, &w, &lh);
+    for (x = 0; x < ctx->view.width; x++)
+        kx[x] = level_pixel(ctx->view.args.ofs_lx + x * ctx->view.args.step_x, h->x1, (h->x2 - h->x1) / h->width * (1 << level), w);
+
+    for (t = 0; t < STORED_THREADS; t++)
+    {
+        rows[t].ctx = ctx;
+        rows[t].f = f;
+        rows[t].kx = kx;
+        rows[t].ys = ctx->view.height * t / STORED_THREADS;
+        rows[t].ye = ctx->view.height * (t + 1) / STORED_THREADS;
+        pthread_create(&tid[t], NULL, fill_stored_rows, &rows[t]);
+    }
+    for (t = 0; t < STORED_THREADS; t++) pthread_join(tid[t], NULL);
+    free(kx);
+    ctx->cpu_execution = get_time_usec() - tp1;
+}
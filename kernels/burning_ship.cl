@@ -36,7 +36,7 @@ __kernel void burning_ship(__global uint* pixels, __global unsigned int* colors,
         z_y = j_y;
         i++;
     }
-    pixels[y * WIDTH + x] = set_color(args, i, colors);
+    pixels[PIXEL_INDEX(args, x, y)] = i;
 #ifdef HOST_APP
     return i;
 #endif
@@ -2,11 +2,11 @@
 
 int test_function(void) { return 123; }
 
+// fractal kernels store numbers of iterations, they are mapped to colors of palette by coloring pass
 unsigned int set_color(struct KERNEL_ARGS args, unsigned int i, __global unsigned int* colors)
 {
     unsigned int color, r, g, b, c;
     float cf;
-    if (args.post_process) return i;
     switch (args.pal)
     {
     case 1:
@@ -27,3 +27,14 @@ unsigned int set_color(struct KERNEL_ARGS args, unsigned int i, __global unsigne
     }
     return color;
 }
+
+#ifndef HOST_APP
+// coloring pass on device, table has colors of numbers of iterations [0, size) built on host
+__kernel void color_frame(__global uint* pixels, __global uint* argb, __global uint* table, uint size)
+{
+    size_t i = get_global_id(0);
+    uint iter = pixels[i];
+
+    argb[i] = table[iter < size ? iter : size - 1];
+}
+#endif
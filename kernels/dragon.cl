@@ -41,9 +41,9 @@ __kernel void dragon(__global uint* pixels, __global unsigned int* colors, struc
             yc = y1;
             x = (args.ofs_lx + x1) / args.step_x;
             y = (args.ofs_ty + y1) / args.step_y;
-            if (x < WIDTH / 2 && y < HEIGHT / 2 && x > -WIDTH / 2 && y > -HEIGHT / 2)
+            if (x < args.width / 2 && y < args.height / 2 && x > -args.width / 2 && y > -args.height / 2)
             {
-                pixels[(HEIGHT / 2 - y) * WIDTH + WIDTH / 2 + x] = 0xff0000 | r * args.mm | args.rgb;
+                pixels[PIXEL_INDEX(args, args.width / 2 + x, args.height / 2 - y)] = 0xff0000 | r * args.mm | args.rgb;
             }
         }
     }
@@ -37,6 +37,8 @@ struct kernel_args64
     float c1[3], c2[3], c3[3], c4[3];
     int mod1;
     int post_process;
+    int width, height; // size of frame in pixels, multiples of 4
+    int stride;        // pixels between rows of frame
 };
 #endif
 struct kernel_args32
@@ -57,6 +59,8 @@ struct kernel_args32
     float c1[3], c2[3], c3[3], c4[3];
     int mod1;
     int post_process;
+    int width, height; // size of frame in pixels, multiples of 4
+    int stride;        // pixels between rows of frame
 };
 
 #ifdef FP_64_SUPPORT
@@ -70,6 +74,13 @@ struct kernel_args32
 #ifdef HOST_APP
 #define __global
 #endif
+
+#ifdef COMPACT_LAYOUT
+// every sub-frame (ofs_x, ofs_y) is stored as continuous block of width/4 x height/4 pixels
+#define PIXEL_INDEX(a, x, y) (((((y)&3) * 4 + ((x)&3)) * ((a).height / 4) + ((y) >> 2)) * ((a).stride / 4) + ((x) >> 2))
+#else
+#define PIXEL_INDEX(a, x, y) ((y) * (a).stride + (x))
+#endif
 unsigned int set_color(struct KERNEL_ARGS args, unsigned int i, __global unsigned int* colors);
 
 #endif
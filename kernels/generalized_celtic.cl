@@ -34,7 +34,7 @@ __kernel void generalized_celtic(__global uint* pixels, __global unsigned int* c
         z_y = j_y;
         i++;
     }
-    pixels[y * WIDTH + x] = set_color(args, i, colors);
+    pixels[PIXEL_INDEX(args, x, y)] = i;
 #ifdef HOST_APP
     return i;
 #endif
@@ -31,7 +31,7 @@ __kernel void julia3(__global uint* pixels, __global unsigned int* colors, struc
         z_y = j_y;
         i++;
     }
-    pixels[y * WIDTH + x] = set_color(args, i, colors);
+    pixels[PIXEL_INDEX(args, x, y)] = i;
 #ifdef HOST_APP
     return i;
 #endif
@@ -33,7 +33,7 @@ __kernel void tricorn(__global uint* pixels, __global unsigned int* colors, stru
         z_y = j_y;
         i++;
     }
-    pixels[y * WIDTH + x] = set_color(args, i, colors);
+    pixels[PIXEL_INDEX(args, x, y)] = i;
 #ifdef HOST_APP
     return i;
 #endif
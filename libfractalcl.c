@@ -0,0 +1,312 @@
+/*
+    Copyright (C) 2018-2019  Jacek Danecki <jacek.m.danecki@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef OPENCL_SUPPORT
+#include "fractal_ocl.h"
+#endif
+#include "libfractalcl.h"
+#include "palette.h"
+#include "render.h"
+#include "timer.h"
+
+struct fcl_context
+{
+    struct render_ctx rc;
+    int width, height;         // size of image of caller, frame is rounded up to multiples of 4
+    struct fcl_view fv;        // view set by caller
+    unsigned long render_time; // [us] last frame calculated and copied to buffer of caller
+    int rendered;              // iterations of frame are kept in rc.pixels and can be colored again
+};
+
+// buffer of caller, rows are copied from CPU frame or from OCL devices
+struct fcl_buffer
+{
+    char* pixels;
+    int pitch;
+    int width, height;
+    struct render_ctx* rc;
+    struct view* v;
+    char* frame;    // iterations of context, rows read from OCL devices are kept in it
+    int iterations; // rows have numbers of iterations, not colors
+};
+
+// palette, OpenCL devices and their kernels, returns 0 on success
+int fcl_init(int opencl)
+{
+    quiet = 1;
+    if (!colors && initialize_colors()) return 1;
+#ifdef OPENCL_SUPPORT
+    if (opencl && init_ocl_devices())
+    {
+        printf("OpenCL device not found\n");
+        return 1;
+    }
+#else
+    if (opencl) return 1;
+#endif
+    return 0;
+}
+
+// all contexts have to be destroyed before
+void fcl_shutdown()
+{
+#ifdef OPENCL_SUPPORT
+    if (__atomic_load_n(&ocl_state, __ATOMIC_ACQUIRE) == OCL_READY)
+    {
+        finish_thread = 1;
+        close_ocl();
+        __atomic_store_n(&ocl_state, OCL_FAILED, __ATOMIC_RELEASE);
+    }
+#endif
+    free(colors);
+    colors = NULL;
+}
+
+int fcl_devices()
+{
+#ifdef OPENCL_SUPPORT
+    if (__atomic_load_n(&ocl_state, __ATOMIC_ACQUIRE) == OCL_READY) return __atomic_load_n(&nr_devices, __ATOMIC_ACQUIRE);
+#endif
+    return 0;
+}
+
+void fcl_default_view(int fractal, struct fcl_view* v)
+{
+    int c;
+
+    memset(v, 0, sizeof(*v));
+    v->fractal = fractal;
+    v->x1 = -1.5;
+    v->x2 = 1.5;
+    v->y1 = 1.5;
+    v->y2 = -1.5;
+    v->c_x = 0.15;
+    v->c_y = -0.60;
+    v->er = 4.0;
+    v->max_iter = 360;
+    v->mm = 1;
+    for (c = 0; c < 3; c++)
+    {
+        v->c1[c] = 0.5f;
+        v->c2[c] = 0.5f;
+        v->c3[c] = 1.0f;
+        v->c4[c] = 0.33f * c;
+    }
+    if (fractal == FCL_DRAGON)
+    {
+        v->max_iter = 10000;
+        v->er = 0.9;
+        v->x1 = 0.0;
+        v->y1 = 0.0;
+    }
+}
+
+/* image of width x height pixels, every pixel has 4 bytes, frames calculated
+   by context cover whole image and cost is proportional to its size */
+int fcl_set_size(struct fcl_context* c, int width, int height)
+{
+    void* pixels;
+    int w = (width + 3) & ~3, h = (height + 3) & ~3;
+
+    if (width <= 0 || height <= 0) return 1;
+    if (w != c->rc.view.width || h != c->rc.view.height)
+    {
+        if (posix_memalign(&pixels, 4096, (size_t)w * h * BPP)) return 1;
+        memset(pixels, 0, (size_t)w * h * BPP);
+        free(c->rc.pixels);
+        c->rc.pixels = pixels;
+        c->rendered = 0;
+        c->rc.view.width = w;
+        c->rc.view.height = h;
+    }
+    c->width = width;
+    c->height = height;
+    // view depends on size of frame
+    if (c->rc.view.max_iter) return fcl_set_view(c, &c->fv);
+    return 0;
+}
+
+// context calculated on CPU or on OpenCL device, NULL if device can't be used
+struct fcl_context* fcl_create(int device, int width, int height)
+{
+    struct fcl_context* c;
+
+#ifdef OPENCL_SUPPORT
+    if (device != FCL_DEVICE_CPU && (__atomic_load_n(&ocl_state, __ATOMIC_ACQUIRE) != OCL_READY || device < 0 ||
+                                     device >= __atomic_load_n(&nr_devices, __ATOMIC_ACQUIRE) || !ocl_devices[device].initialized))
+        return NULL;
+#else
+    if (device != FCL_DEVICE_CPU) return NULL;
+#endif
+    if (!colors) return NULL;
+
+    c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    if (fcl_set_size(c, width, height))
+    {
+        free(c);
+        return NULL;
+    }
+    c->rc.colors = colors;
+    c->rc.generation = NULL;
+    c->rc.view.cur_dev = device != FCL_DEVICE_CPU;
+    c->rc.view.device = device != FCL_DEVICE_CPU ? device : 0;
+    c->rc.view.draw_frames = 16;
+    return c;
+}
+
+void fcl_destroy(struct fcl_context* c)
+{
+    if (!c) return;
+    release_palette_table(&c->rc.palette);
+    free(c->rc.pixels);
+    free(c);
+}
+
+int fcl_set_view(struct fcl_context* c, const struct fcl_view* v)
+{
+    struct view* rv = &c->rc.view;
+    int d, i;
+
+    if (v->fractal < 0 || v->fractal >= NR_FRACTALS || !v->max_iter) return 1;
+    if (v->fractal != c->fv.fractal) c->rendered = 0;
+    c->fv = *v;
+
+    // fractals calculated in full resolution don't use sub-frames
+    d = (v->fractal == JULIA_FULL || v->fractal == DRAGON) ? 1 : 4;
+    rv->fractal = v->fractal;
+    rv->gws_x = rv->width / d;
+    rv->gws_y = rv->height / d;
+    // bounds are given for image, rounded frame extends them by its extra columns and rows
+    rv->ofs_lx = v->x1;
+    rv->ofs_rx = v->x1 + (v->x2 - v->x1) * rv->width / c->width;
+    rv->ofs_ty = v->y1;
+    rv->ofs_by = v->y1 + (v->y2 - v->y1) * rv->height / c->height;
+    rv->dx = 0;
+    rv->dy = 0;
+    rv->szx = 1;
+    rv->szy = 1;
+    rv->c_x = v->c_x;
+    rv->c_y = v->c_y;
+    rv->er = v->er;
+    rv->max_iter = v->max_iter;
+    rv->pal = v->pal;
+    rv->rgb = v->rgb;
+    rv->mm = v->mm;
+    rv->mod1 = v->mod1;
+    rv->postprocess = v->postprocess;
+    rv->equalize = v->equalize;
+    for (i = 0; i < 3; i++)
+    {
+        rv->c1[i] = v->c1[i];
+        rv->c2[i] = v->c2[i];
+        rv->c3[i] = v->c3[i];
+        rv->c4[i] = v->c4[i];
+    }
+    view_kernel_args(rv);
+    return 0;
+}
+
+void copy_rows_to_buffer(void* data, int y1, int y2, void* rows)
+{
+    struct fcl_buffer* b = data;
+    char* frame = b->frame + (size_t)y1 * FRAME_PITCH(b->v);
+    int y;
+
+    // context keeps iterations, so frame can be colored again by fcl_color
+    if (rows != frame) memcpy(frame, rows, (size_t)(y2 - y1) * FRAME_PITCH(b->v));
+    if (y2 > b->height) y2 = b->height;
+    if (y1 >= y2) return;
+    if (!b->iterations)
+    {
+        // equalized image is colored when all rows are read
+        if (!b->v->equalize) color_rows(&b->rc->palette, b->v, frame, FRAME_PITCH(b->v), b->pixels + (size_t)y1 * b->pitch, b->pitch, b->width, y2 - y1);
+        return;
+    }
+    for (y = y1; y < y2; y++) memcpy(b->pixels + (size_t)y * b->pitch, frame + (size_t)(y - y1) * FRAME_PITCH(b->v), b->width * BPP);
+}
+
+int render_to_buffer(struct fcl_context* c, void* buffer, int pitch, int iterations)
+{
+    struct fcl_buffer b = {buffer, pitch, c->width, c->height, &c->rc, &c->rc.view, c->rc.pixels, iterations};
+    unsigned long tp1;
+
+    if (!c->rc.view.max_iter || pitch < c->width * BPP) return 1;
+
+    tp1 = get_time_usec();
+#ifdef OPENCL_SUPPORT
+    if (c->rc.view.cur_dev)
+    {
+        // other contexts on the same device wait until frame is read from its buffers
+        lock_ocl(&c->rc.view);
+        // dragon is drawn on cleared buffer
+        if (c->rc.view.fractal == DRAGON) clear_pixels_ocl(c->rc.view.device);
+        calculate_frame(&c->rc);
+        swap_ocl_buffers(&c->rc);
+        read_frame_ocl(&c->rc.view, copy_rows_to_buffer, &b);
+        unlock_ocl(&c->rc.view);
+    }
+    else
+#endif
+    {
+        calculate_frame(&c->rc);
+        copy_rows_to_buffer(&b, 0, c->rc.view.height, c->rc.pixels);
+    }
+    if (!iterations && c->rc.view.equalize) color_rows(&c->rc.palette, &c->rc.view, c->rc.pixels, FRAME_PITCH(&c->rc.view), buffer, pitch, c->width, c->height);
+    c->render_time = get_time_usec() - tp1;
+    c->rendered = 1;
+    return 0;
+}
+
+/* calculate frame of view and copy it to buffer with height rows of pitch bytes,
+   every row has width pixels, returns 0 on success */
+int fcl_render(struct fcl_context* c, void* buffer, int pitch) { return render_to_buffer(c, buffer, pitch, 0); }
+
+// like fcl_render, but pixels are numbers of iterations, dragon doesn't have them
+int fcl_render_iterations(struct fcl_context* c, unsigned int* buffer, int pitch)
+{
+    if (c->rc.view.fractal == DRAGON) return 1;
+    return render_to_buffer(c, buffer, pitch, 1);
+}
+
+/* color frame of last fcl_render again with palette of current view, so palette set by
+   fcl_set_view is applied in milliseconds, without calculation of frame */
+int fcl_color(struct fcl_context* c, void* buffer, int pitch)
+{
+    if (!c->rendered || pitch < c->width * BPP) return 1;
+    color_rows(&c->rc.palette, &c->rc.view, c->rc.pixels, FRAME_PITCH(&c->rc.view), buffer, pitch, c->width, c->height);
+    return 0;
+}
+
+// 1 if frames of context are calculated in double precision
+int fcl_fp64(struct fcl_context* c)
+{
+#ifdef OPENCL_SUPPORT
+    if (c->rc.view.cur_dev) return ocl_devices[c->rc.view.device].fp64;
+#endif
+    return sizeof(FP_TYPE) == sizeof(double);
+}
+
+// number of iterations of pixel (x, y) of last rendered frame, 0 before the first render, dragon doesn't have iterations
+unsigned int fcl_iterations(struct fcl_context* c, int x, int y)
+{
+    if (x < 0 || x >= c->width || y < 0 || y >= c->height || !c->rendered || c->rc.view.fractal == DRAGON) return 0;
+    return ((unsigned int*)c->rc.pixels)[y * c->rc.view.width + x];
+}
+
+// [us] time of last fcl_render
+unsigned long fcl_render_time(struct fcl_context* c) { return c->render_time; }
@@ -17,34 +17,32 @@
 
 #include "fractal_ocl.h"
 #include "window.h"
+#include <errno.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 
-volatile int nr_devices;
+int nr_devices;
+volatile int ocl_steps, ocl_steps_done; // compilation progress: programs and kernels
 struct ocl_device* ocl_devices;
 int current_device;
 struct ocl_fractal fractals[NR_FRACTALS];
 struct ocl_fractal test_fractal, common_functions;
+struct ocl_fractal color_function = {"color_frame"}; // kernel of common.cl
 extern int quiet;
 
-int create_ocl_device(int di, char* plat_name, cl_platform_id id)
+int create_ocl_device(int di, char* plat_name, cl_platform_id id, cl_device_id device_id)
 {
     int err;
-    unsigned int num;
     struct ocl_device* dev = &ocl_devices[di];
     size_t size;
-    cl_context_properties prop[3];
+    cl_bool unified;
 
     if (!strncmp(plat_name, "Intel", 5)) dev->intel = 1;
     if (!strncmp(plat_name, "Portable", 8)) dev->pocl = 1;
 
-    err = clGetDeviceIDs(id, CL_DEVICE_TYPE_ALL, 0, NULL, &num);
-    if ((err != CL_SUCCESS) || (num != 1))
-    {
-        printf("OpenCL device not found err=%d\n", err);
-        return 1;
-    }
-
-    err = clGetDeviceIDs(id, CL_DEVICE_TYPE_ALL, 1, &dev->device_id, NULL);
+    dev->device_id = device_id;
+    dev->platform_id = id;
 
     err = clGetDeviceInfo(dev->device_id, CL_DEVICE_NAME, 0, NULL, &size);
     if (size > 4095) return 1;
@@ -117,17 +115,80 @@ int create_ocl_device(int di, char* plat_name, cl_platform_id id)
     }
     if (!quiet) printf("MAX_WORKGROUP_SIZE=%lu\n", dev->wgs);
 
+    err = clGetDeviceInfo(dev->device_id, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &unified, NULL);
+    if (err != CL_SUCCESS) unified = CL_FALSE;
+    dev->zero_copy = unified || dev->type == CL_DEVICE_TYPE_CPU;
+    if (!quiet) printf("HOST_UNIFIED_MEMORY=%u zero copy=%d\n", unified, dev->zero_copy);
+    return 0;
+}
+
+/* all devices of one platform share context and program,
+   every device has own command queue, kernels and buffers */
+int create_platform_devices(char* plat_name, cl_platform_id id)
+{
+    int err, d, fp64 = 1;
+    unsigned int num;
+    cl_device_id* ids;
+    cl_context ctx;
+    cl_context_properties prop[3];
+
+    err = clGetDeviceIDs(id, CL_DEVICE_TYPE_ALL, 0, NULL, &num);
+    if (err == CL_DEVICE_NOT_FOUND || (err == CL_SUCCESS && !num))
+    {
+        if (!quiet) printf("no devices on platform %s\n", plat_name);
+        return 0;
+    }
+    if (err != CL_SUCCESS)
+    {
+        printf("OpenCL device not found err=%d\n", err);
+        return 1;
+    }
+
+    ids = malloc(num * sizeof(cl_device_id));
+    err = clGetDeviceIDs(id, CL_DEVICE_TYPE_ALL, num, ids, NULL);
+    if (err != CL_SUCCESS)
+    {
+        printf("clGetDeviceIDs returned %d\n", err);
+        free(ids);
+        return 1;
+    }
+
     prop[0] = CL_CONTEXT_PLATFORM;
     prop[1] = (cl_context_properties)id;
     prop[2] = 0;
-    dev->ctx = clCreateContext(prop, 1, &dev->device_id, NULL, NULL, &err);
+    ctx = clCreateContext(prop, num, ids, NULL, NULL, &err);
     if (err != CL_SUCCESS)
     {
         printf("clCreateContext returned %d\n", err);
+        free(ids);
         return 1;
     }
-    dev->platform_id = id;
-    dev->initialized = 1;
+
+    for (d = 0; d < num; d++)
+    {
+        struct ocl_device* dev = &ocl_devices[nr_devices];
+
+        if (create_ocl_device(nr_devices, plat_name, id, ids[d]))
+        {
+            // devices created before hold their references of context
+            if (!d) clReleaseContext(ctx);
+            free(ids);
+            return 1;
+        }
+        if (d) clRetainContext(ctx);
+        dev->ctx = ctx;
+        dev->initialized = 1;
+        fp64 &= dev->fp64;
+        __atomic_store_n(&nr_devices, nr_devices + 1, __ATOMIC_RELEASE);
+    }
+
+    // one program is built for all devices, so fp64 can be used only if all of them support it
+    for (d = nr_devices - num; d < nr_devices; d++)
+    {
+        if (ocl_devices[d].fp64 && !fp64 && !quiet) printf("%s: fp64 disabled, not supported by other devices on platform\n", ocl_devices[d].name);
+        ocl_devices[d].fp64 = fp64;
+    }
+    free(ids);
     return 0;
 }
 
@@ -144,6 +205,7 @@ int create_kernel(struct ocl_device* dev, struct ocl_fractal* fractal, cl_kernel
         printf("%s: clCreateKernel [%s] returned %d\n", dev->name, name, err);
         return 1;
     }
+    ocl_steps_done++;
 
     err = clGetKernelWorkGroupInfo(*kernel, dev->device_id, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(size_t), &param1, NULL);
     if (err != CL_SUCCESS)
@@ -173,18 +235,50 @@ int create_kernel(struct ocl_device* dev, struct ocl_fractal* fractal, cl_kernel
     return 0;
 }
 
-int create_kernels(struct ocl_device* dev, char* options)
+int create_device_kernels(struct ocl_device* dev)
+{
+    int err;
+
+    if (!dev->queue)
+    {
+        dev->queue = clCreateCommandQueue(dev->ctx, dev->device_id, 0, &err);
+        if (err != CL_SUCCESS)
+        {
+            printf("%s: clCreateCommandQueue on GPU returned %d\n", dev->name, err);
+            return 1;
+        }
+    }
+
+    if (create_kernel(dev, &fractals[JULIA], &dev->kernels[JULIA])) return 1;
+    if (create_kernel(dev, &fractals[MANDELBROT], &dev->kernels[MANDELBROT])) return 1;
+    if (create_kernel(dev, &fractals[JULIA_FULL], &dev->kernels[JULIA_FULL])) return 1;
+    if (create_kernel(dev, &fractals[DRAGON], &dev->kernels[DRAGON])) return 1;
+    if (create_kernel(dev, &fractals[JULIA3], &dev->kernels[JULIA3])) return 1;
+    if (create_kernel(dev, &fractals[BURNING_SHIP], &dev->kernels[BURNING_SHIP])) return 1;
+    if (create_kernel(dev, &fractals[GENERALIZED_CELTIC], &dev->kernels[GENERALIZED_CELTIC])) return 1;
+    if (create_kernel(dev, &fractals[TRICORN], &dev->kernels[TRICORN])) return 1;
+
+    if (create_kernel(dev, &test_fractal, &dev->test_kernel)) return 1;
+    if (create_kernel(dev, &color_function, &dev->color_kernel)) return 1;
+    return 0;
+}
+
+// build one program for n devices from the same platform
+int create_kernels(struct ocl_device* devs, int n, char* options)
 {
-    int err, i;
+    int err, i, d, compact;
     size_t size;
     char* log;
 
     char* sources[NR_FRACTALS + 2]; // 1 more for test_kernel, 1 for common.cl
     char cl_options[1024];
     size_t filesizes[NR_FRACTALS + 2];
-    if (!dev->initialized) return 0;
+    cl_device_id ids[n];
+    cl_program program;
+
+    if (!devs->initialized) return 0;
 
-    if (!quiet) printf("prepare kernels for %s\n", dev->name);
+    if (!quiet) printf("prepare kernels for %s (%d device(s) on platform)\n", devs->name, n);
 
     for (i = 0; i < NR_FRACTALS; i++)
     {
@@ -200,48 +294,55 @@ int create_kernels(struct ocl_device* dev, char* options)
     filesizes[i + 1] = common_functions.filesize;
     if (!quiet) printf("preparing kernel: %s\n", common_functions.name);
 
-    sprintf(cl_options, "%s -D HEIGHT_FL=%f -D HEIGHT=%d -D WIDTH_FL=%f -D "
-                        "WIDTH=%d -D BPP=%d -D PITCH=%d %s -I%s/kernels",
-            options ? options : "", HEIGHT_FL, HEIGHT, WIDTH_FL, WIDTH, BPP, PITCH, dev->fp64 ? "-DFP_64_SUPPORT=1" : "", STRING_MACRO(DATA_PATH));
-    dev->program = clCreateProgramWithSource(dev->ctx, NR_FRACTALS + 2, (const char**)sources, filesizes, &err);
+    /* devices without zero copy read only sub-frames calculated in last pass, so keep them continuous,
+       zero copy devices map frame in screen layout, layout is compiled in, so all devices of program use the same one */
+    compact = 1;
+    for (d = 0; d < n; d++)
+        if (devs[d].zero_copy) compact = 0;
+    for (d = 0; d < n; d++) devs[d].compact = compact;
+
+    // size of frame is passed in kernel arguments, so one build serves frames of any size
+    sprintf(cl_options, "%s %s %s -I%s/kernels", options ? options : "", devs->fp64 ? "-DFP_64_SUPPORT=1" : "", compact ? "-DCOMPACT_LAYOUT=1" : "",
+            STRING_MACRO(DATA_PATH));
+    program = clCreateProgramWithSource(devs->ctx, NR_FRACTALS + 2, (const char**)sources, filesizes, &err);
     if (err != CL_SUCCESS)
     {
-        printf("%s: clCreateProgramWithSource returned %d\n", dev->name, err);
+        printf("%s: clCreateProgramWithSource returned %d\n", devs->name, err);
         return 1;
     }
-    if (!quiet) printf("compiling kernels with %s\n", cl_options);
-    err = clBuildProgram(dev->program, 1, &dev->device_id, cl_options, NULL, NULL);
-    if (!quiet) printf("%s: clBuildProgram returned %d\n", dev->name, err);
+    for (d = 0; d < n; d++) ids[d] = devs[d].device_id;
 
-    if (!quiet) printf("%s: ------ compilation log  -----------\n", dev->name);
-    clGetProgramBuildInfo(dev->program, dev->device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &size);
-    log = calloc(1, size);
-    clGetProgramBuildInfo(dev->program, dev->device_id, CL_PROGRAM_BUILD_LOG, size, log, NULL);
-    if (!quiet) printf("%s\n", log);
-    free(log);
+    if (!quiet) printf("compiling kernels with %s\n", cl_options);
+    err = clBuildProgram(program, n, ids, cl_options, NULL, NULL);
+    if (!quiet) printf("%s: clBuildProgram returned %d\n", devs->name, err);
 
-    if (err != CL_SUCCESS)
+    for (d = 0; d < n; d++)
     {
-        return 1;
+        if (!quiet) printf("%s: ------ compilation log  -----------\n", devs[d].name);
+        clGetProgramBuildInfo(program, ids[d], CL_PROGRAM_BUILD_LOG, 0, NULL, &size);
+        log = calloc(1, size);
+        clGetProgramBuildInfo(program, ids[d], CL_PROGRAM_BUILD_LOG, size, log, NULL);
+        if (!quiet) printf("%s\n", log);
+        free(log);
     }
 
-    dev->queue = clCreateCommandQueue(dev->ctx, dev->device_id, 0, &err);
+    // devices keep released program handles NULL when build fails
     if (err != CL_SUCCESS)
     {
-        printf("%s: clCreateCommandQueue on GPU returned %d\n", dev->name, err);
+        clReleaseProgram(program);
         return 1;
     }
+    for (d = 0; d < n; d++)
+    {
+        if (d) clRetainProgram(program);
+        devs[d].program = program;
+    }
+    ocl_steps_done++;
 
-    if (create_kernel(dev, &fractals[JULIA], &dev->kernels[JULIA])) return 1;
-    if (create_kernel(dev, &fractals[MANDELBROT], &dev->kernels[MANDELBROT])) return 1;
-    if (create_kernel(dev, &fractals[JULIA_FULL], &dev->kernels[JULIA_FULL])) return 1;
-    if (create_kernel(dev, &fractals[DRAGON], &dev->kernels[DRAGON])) return 1;
-    if (create_kernel(dev, &fractals[JULIA3], &dev->kernels[JULIA3])) return 1;
-    if (create_kernel(dev, &fractals[BURNING_SHIP], &dev->kernels[BURNING_SHIP])) return 1;
-    if (create_kernel(dev, &fractals[GENERALIZED_CELTIC], &dev->kernels[GENERALIZED_CELTIC])) return 1;
-    if (create_kernel(dev, &fractals[TRICORN], &dev->kernels[TRICORN])) return 1;
-
-    if (create_kernel(dev, &test_fractal, &dev->test_kernel)) return 1;
+    for (d = 0; d < n; d++)
+    {
+        if (create_device_kernels(&devs[d])) return 1;
+    }
 
     if (!quiet) printf("------------------------------------------\n");
     return 0;
@@ -270,11 +371,31 @@ void close_fractal(struct ocl_fractal* fractal)
     close(fractal->fd);
 }
 
+// number of devices from the same platform starting from device first
+int platform_devices(int first)
+{
+    int n = 1;
+
+    while (first + n < nr_devices && ocl_devices[first + n].platform_id == ocl_devices[first].platform_id) n++;
+    return n;
+}
+
+/* build options of program shared by n devices from device first, devices of platform are tuned together,
+   so any of them with entry in tuning database has options of whole platform */
+char* platform_options(int first, int n)
+{
+    int d;
+
+    for (d = first; d < first + n; d++)
+        if (ocl_devices[d].options[0]) return ocl_devices[d].options;
+    return "-w -cl-mad-enable ";
+}
+
 int init_ocl()
 {
-    int err = 0, i;
+    int err = 0, i, n;
     size_t size;
-    unsigned int nr_platforms;
+    unsigned int nr_platforms, num, total = 0, programs = 0;
     cl_platform_id* platforms_ids;
     char name[256];
 
@@ -299,7 +420,19 @@ int init_ocl()
         goto deallocate_return;
     }
 
-    ocl_devices = calloc(nr_platforms, sizeof(struct ocl_device));
+    for (i = 0; i < nr_platforms; i++)
+    {
+        if (clGetDeviceIDs(platforms_ids[i], CL_DEVICE_TYPE_ALL, 0, NULL, &num) == CL_SUCCESS) total += num;
+    }
+    if (!total)
+    {
+        printf("OpenCL devices not found\n");
+        err = 1;
+        goto deallocate_return;
+    }
+
+    ocl_devices = calloc(total, sizeof(struct ocl_device));
+    for (i = 0; i < total; i++) pthread_mutex_init(&ocl_devices[i].lock, NULL);
     for (i = 0; i < nr_platforms; i++)
     {
         err = clGetPlatformInfo(platforms_ids[i], CL_PLATFORM_NAME, 0, NULL, &size);
@@ -310,12 +443,13 @@ int init_ocl()
         }
         err = clGetPlatformInfo(platforms_ids[i], CL_PLATFORM_NAME, size, name, NULL);
         if (!quiet) printf("--- platform: %s\n", name);
-        if (create_ocl_device(i, name, platforms_ids[i]))
+        n = nr_devices;
+        if (create_platform_devices(name, platforms_ids[i]))
         {
             err = 1;
             goto deallocate_return;
         }
-        nr_devices++;
+        if (nr_devices > n) programs++;
     }
     current_device = 0;
     open_fractal(&fractals[JULIA], "julia");
@@ -330,35 +464,252 @@ int init_ocl()
     open_fractal(&test_fractal, "test_kernel");
     open_fractal(&common_functions, "common");
 
-    for (i = 0; i < nr_devices; i++) err |= create_kernels(&ocl_devices[i], "-w -cl-mad-enable ");
+    ocl_steps = programs + nr_devices * (NR_FRACTALS + 2); // programs + fractal kernels + test kernel + color kernel
+    load_tuning();
+    for (i = 0; i < nr_devices; i += n)
+    {
+        n = platform_devices(i);
+        err |= create_kernels(&ocl_devices[i], n, platform_options(i, n));
+    }
 
 deallocate_return:
     free(platforms_ids);
     return err;
 }
 
-void close_device(struct ocl_device* dev)
+// handles are cleared, so kernels can be released again after failed build
+void release_kernels(struct ocl_device* dev)
 {
-    int err, i;
-    if (!dev->initialized) return;
+    int i;
+
+    for (i = 0; i < NR_FRACTALS; i++)
+    {
+        if (dev->kernels[i]) clReleaseKernel(dev->kernels[i]);
+        dev->kernels[i] = NULL;
+    }
+    if (dev->test_kernel) clReleaseKernel(dev->test_kernel);
+    dev->test_kernel = NULL;
+    if (dev->color_kernel) clReleaseKernel(dev->color_kernel);
+    dev->color_kernel = NULL;
+    if (dev->program) clReleaseProgram(dev->program);
+    dev->program = NULL;
+}
+
+/* tuning database, one line for every tuned kernel:
+   device name|driver version|kernel|local size x|local size y|build options
+   build options are the same for all kernels of one device */
+void tuning_file_name(char* name, int size)
+{
+    char* env = getenv("FRACTALCL_TUNING");
+    char* home = getenv("HOME");
+
+    if (env)
+        snprintf(name, size, "%s", env);
+    else
+        snprintf(name, size, "%s/.FractalCL.tuning", home ? home : ".");
+}
+
+int load_tuning()
+{
+    char name[512];
+    char line[1024];
+    FILE* f;
+    int d, i, entries = 0;
+
+    tuning_file_name(name, sizeof(name));
+    f = fopen(name, "r");
+    if (!f) return 0;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        char *dev_name, *driver, *kernel, *lws_x, *lws_y, *options, *save;
+
+        if (line[0] == '#') continue;
+        line[strcspn(line, "\n")] = 0;
+        dev_name = strtok_r(line, "|", &save);
+        driver = strtok_r(NULL, "|", &save);
+        kernel = strtok_r(NULL, "|", &save);
+        lws_x = strtok_r(NULL, "|", &save);
+        lws_y = strtok_r(NULL, "|", &save);
+        options = strtok_r(NULL, "|", &save);
+        if (!lws_y) continue;
+
+        for (d = 0; d < nr_devices; d++)
+        {
+            struct ocl_device* dev = &ocl_devices[d];
+
+            if (strcmp(dev->name, dev_name) || strcmp(dev->driver_version, driver)) continue;
+            for (i = 0; i < NR_FRACTALS; i++)
+            {
+                if (strcmp(fractals[i].name, kernel)) continue;
+                dev->lws[i][0] = strtoul(lws_x, NULL, 0);
+                dev->lws[i][1] = strtoul(lws_y, NULL, 0);
+                entries++;
+            }
+            if (options) snprintf(dev->options, sizeof(dev->options), "%s", options);
+        }
+    }
+    fclose(f);
+    if (!quiet) printf("loaded %d tuned kernels from %s\n", entries, name);
+    return entries;
+}
+
+#define SPIN_COUNT 1000 // checks of empty ring before consumer goes to sleep
+
+int init_ring(struct ocl_ring* r)
+{
+    r->head = r->tail = 0;
+    r->sleeping = 0;
+    r->fd = eventfd(0, EFD_CLOEXEC);
+    if (r->fd < 0)
+    {
+        printf("eventfd failed, errno=%d\n", errno);
+        return 1;
+    }
+    return 0;
+}
+
+// publish entry written at tail, wake up consumer only if it sleeps
+void ring_push(struct ocl_ring* r)
+{
+    uint64_t one = 1;
+
+    __atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&r->sleeping, __ATOMIC_SEQ_CST))
+    {
+        if (write(r->fd, &one, sizeof(one)) < 0) printf("eventfd write failed, errno=%d\n", errno);
+    }
+}
 
-    pthread_cond_signal(&dev->thread.cond);
+/* wait until entry at head is available, returns 1 without entry when finish_thread is set
+   and exit is non zero */
+int ring_wait(struct ocl_ring* r, int exit)
+{
+    uint64_t count;
+    int spin;
 
-    while (pthread_cond_destroy(&dev->thread.cond))
+    for (;;)
     {
-        pthread_cond_signal(&dev->thread.cond);
-        sched_yield();
+        if (exit && __atomic_load_n(&finish_thread, __ATOMIC_SEQ_CST)) return 1;
+        for (spin = 0; spin < SPIN_COUNT; spin++)
+        {
+            if (__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) != r->head) return 0;
+        }
+        __atomic_store_n(&r->sleeping, 1, __ATOMIC_SEQ_CST);
+        // producer checks sleeping after tail was published, so entry pushed now isn't missed
+        if (__atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) == r->head && !(exit && __atomic_load_n(&finish_thread, __ATOMIC_SEQ_CST)))
+        {
+            if (read(r->fd, &count, sizeof(count)) < 0 && errno != EINTR) printf("eventfd read failed, errno=%d\n", errno);
+        }
+        __atomic_store_n(&r->sleeping, 0, __ATOMIC_SEQ_CST);
     }
+}
 
-    pthread_join(dev->thread.tid, NULL);
-    pthread_mutex_destroy(&dev->thread.lock);
+// entry at head was consumed, its slot can be reused by producer
+void ring_pop(struct ocl_ring* r) { __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE); }
 
-    clReleaseProgram(dev->program);
+int ring_full(struct ocl_ring* r) { return r->tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == RING_SIZE; }
 
-    for (i = 0; i < NR_FRACTALS; i++) clReleaseKernel(dev->kernels[i]);
+int start_rings(struct ocl_thread* t)
+{
+    if (init_ring(&t->job_ring)) return 1;
+    if (init_ring(&t->done_ring)) return 1;
+    t->pending = 0;
+    t->finished = 0;
+    return 0;
+}
 
-    clReleaseMemObject(dev->cl_pixels);
+// called by render thread, returns 1 if device can't take more jobs
+int post_job(struct ocl_thread* t, struct ocl_job* job)
+{
+    if (ring_full(&t->job_ring)) return 1;
+    t->jobs[t->job_ring.tail % RING_SIZE] = *job;
+    ring_push(&t->job_ring);
+    t->pending++;
+    return 0;
+}
+
+// called by device thread, returns 1 when thread has to exit
+int take_job(struct ocl_thread* t, struct ocl_job* job)
+{
+    if (ring_wait(&t->job_ring, 1)) return 1;
+    *job = t->jobs[t->job_ring.head % RING_SIZE];
+    ring_pop(&t->job_ring);
+    return 0;
+}
+
+// called by device thread, there is at most one completion for every posted job
+void post_completion(struct ocl_thread* t, struct ocl_completion* c)
+{
+    t->done[t->done_ring.tail % RING_SIZE] = *c;
+    ring_push(&t->done_ring);
+}
+
+// called by render thread, waits for completion of oldest pending job
+void take_completion(struct ocl_thread* t, struct ocl_completion* c)
+{
+    ring_wait(&t->done_ring, 0);
+    *c = t->done[t->done_ring.head % RING_SIZE];
+    ring_pop(&t->done_ring);
+    t->pending--;
+}
+
+// finish_thread is set, wake up device thread sleeping for jobs and wait for it
+void stop_thread(struct ocl_thread* t)
+{
+    uint64_t one = 1;
+
+    if (!t->tid) return;
+    if (write(t->job_ring.fd, &one, sizeof(one)) < 0) printf("eventfd write failed, errno=%d\n", errno);
+    pthread_join(t->tid, NULL);
+    close(t->job_ring.fd);
+    close(t->done_ring.fd);
+    t->tid = 0;
+}
+
+// pixel buffers, staging memory and host frame of device, also partially created ones
+void release_pixels(struct ocl_device* dev)
+{
+    int i;
+
+    for (i = 0; i < dev->nr_buffers; i++)
+    {
+        if (dev->buffers[i].pixels) clReleaseMemObject(dev->buffers[i].pixels);
+        if (dev->buffers[i].argb) clReleaseMemObject(dev->buffers[i].argb);
+        memset(&dev->buffers[i], 0, sizeof(dev->buffers[i]));
+    }
+    dev->nr_buffers = 0;
+    free(dev->host_pixels);
+    dev->host_pixels = NULL;
+    free(dev->host_argb);
+    dev->host_argb = NULL;
+    if (dev->staging)
+    {
+        clEnqueueUnmapMemObject(dev->queue, dev->cl_staging, dev->staging, 0, NULL, NULL);
+        clFinish(dev->queue);
+    }
+    if (dev->cl_staging) clReleaseMemObject(dev->cl_staging);
+    if (dev->frame != dev->staging) free(dev->frame);
+    dev->cl_staging = NULL;
+    dev->staging = NULL;
+    dev->frame = NULL;
+    dev->width = 0;
+    dev->height = 0;
+}
+
+void close_device(struct ocl_device* dev)
+{
+    int err;
+    if (!dev->initialized) return;
+
+    stop_thread(&dev->thread);
+
+    release_kernels(dev);
+
+    release_pixels(dev);
     clReleaseMemObject(dev->cl_colors);
+    if (dev->cl_palette) clReleaseMemObject(dev->cl_palette);
+    if (dev->read_queue) clReleaseCommandQueue(dev->read_queue);
 
     err = clReleaseCommandQueue(dev->queue);
     if (err != CL_SUCCESS)
@@ -377,8 +728,17 @@ void close_device(struct ocl_device* dev)
 int close_ocl()
 {
     int i;
-    for (i = 0; i < nr_devices; i++) close_device(&ocl_devices[i]);
+    for (i = 0; i < nr_devices; i++)
+    {
+        close_device(&ocl_devices[i]);
+        pthread_mutex_destroy(&ocl_devices[i].lock);
+    }
     free(ocl_devices);
+    // devices can be initialized again, their threads have to run until next close
+    ocl_devices = NULL;
+    __atomic_store_n(&nr_devices, 0, __ATOMIC_RELEASE);
+    ocl_steps_done = 0;
+    finish_thread = 0;
     for (i = 0; i < NR_FRACTALS; i++)
     {
         close_fractal(&fractals[i]);
@@ -15,9 +15,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "fractal_ocl.h"
-#include "gui.h"
-#include "parameters.h"
+#include "palette.h"
+#include "window.h"
 #include <math.h>
 #include <stdlib.h>
 
@@ -151,9 +150,6 @@ void hsv2rgb(int h, int s, int v, int* r, int* g, int* b)
 int initialize_colors()
 {
     int err, iter;
-#ifdef OPENCL_SUPPORT
-    int d;
-#endif
     // h [0..359]
     // s [1]
     // v [0, 1]
@@ -219,171 +215,16 @@ int initialize_colors()
     }
     colors[0] = 0;
     colors[360] = (colors[359] + colors[361]) / 2;
-#ifdef OPENCL_SUPPORT
-    for (d = 0; d < nr_devices; d++)
-    {
-        if (prepare_colors(&ocl_devices[d])) return 1;
-        if (prepare_pixels(&ocl_devices[d])) return 1;
-        if (prepare_thread(&ocl_devices[d])) return 1;
-    }
-#endif
     return 0;
 }
 
 unsigned int get_color(int c) { return colors[c % 360]; }
 
-void show_hsv_palette()
-{
-    int x;
-    SDL_Rect dst;
-
-    dst.w = WIDTH;
-    dst.x = 0;
-    dst.y = 0;
-    dst.h = HEIGHT;
-
-    SDL_SetRenderDrawColor(main_window, 0, 0, 0, 255);
-    SDL_RenderFillRect(main_window, &dst);
-
-    for (x = 0; x < WIDTH; x++)
-    {
-        unsigned int c = get_color(x);
-        int r = (c & 0xff0000) >> 16;
-        int g = (c & 0x00ff00) >> 8;
-        int b = c & 0xff;
-        SDL_SetRenderDrawColor(main_window, r, g, b, 255);
-        SDL_RenderDrawLine(main_window, x, 0, x, HEIGHT / 2);
-
-        c |= rgb;
-        r = (c & 0xff0000) >> 16;
-        g = (c & 0x00ff00) >> 8;
-        b = c & 0xff;
-        SDL_SetRenderDrawColor(main_window, r, g, b, 255);
-        SDL_RenderDrawLine(main_window, x, HEIGHT / 2, x, HEIGHT - 40);
-    }
-}
-
-void show_rgb_palette1()
-{
-    unsigned char* pixels;
-    int pitch, x, y;
-    int nx, ny;
-
-    SDL_Rect window_rec;
-    SDL_LockTexture(texture, NULL, (void**)&pixels, &pitch);
-
-    window_rec.w = WIDTH;
-    window_rec.h = HEIGHT;
-    window_rec.x = 0;
-    window_rec.y = 0;
-    memset(pixels, 0, pitch * HEIGHT);
-    for (y = -255; y < 256; y++)
-    {
-        for (x = -255; x < 256; x++)
-        {
-            int r = sqrt(x * x + y * y);
-            if (r < 256)
-            {
-                r = (255 - r) * mm;
-                nx = (256 + x) << 2;
-                ny = pitch * (256 + y);
-                pixels[ny + nx + 2] |= (r | (rgb & 255));
-                pixels[ny + nx + 3] = 255;
-
-                nx = (384 + x) << 2;
-                ny = pitch * (256 + y);
-                pixels[ny + nx + 1] |= (r | ((rgb & 0x00ff00) >> 8));
-                pixels[ny + nx + 3] = 255;
-
-                nx = (320 + x) << 2;
-                ny = pitch * (384 + y);
-                pixels[ny + nx] |= (r | ((rgb & 0xff0000) >> 16));
-                pixels[ny + nx + 3] = 255;
-            }
-        }
-    }
-    SDL_UnlockTexture(texture);
-    SDL_RenderCopy(main_window, texture, NULL, &window_rec);
-}
-
-void show_rgb_palette2()
+unsigned int postprocess_color(unsigned int i, unsigned int max_iter)
 {
-    unsigned char* pixels;
-    int pitch, x, y;
-    int nx, ny;
+    unsigned char r = 255.0 * i / max_iter;
+    unsigned char g = 128 + 127 * sin(i);
+    unsigned char b = 128 + 127 * cos(i);
 
-    SDL_Rect window_rec;
-    SDL_LockTexture(texture, NULL, (void**)&pixels, &pitch);
-
-    window_rec.w = WIDTH;
-    window_rec.h = HEIGHT;
-    window_rec.x = 0;
-    window_rec.y = 0;
-    memset(pixels, 0, pitch * HEIGHT);
-    for (y = -255; y < 256; y++)
-    {
-        for (x = -255; x < 256; x++)
-        {
-            unsigned int r = sqrt(x * x + y * y);
-            if (r < 256)
-            {
-                float cf;
-                r = 255 - r;
-                cf = 1.0 * r / 255.0;
-                r = 255 * (c1[2] + c2[2] * cos(6.2830 * (c3[2] * cf + c4[2])));
-                nx = (256 + x) << 2;
-                ny = pitch * (256 + y);
-                pixels[ny + nx + 2] |= r;
-                pixels[ny + nx + 3] = 255;
-
-                r = 255 * (c1[1] + c2[1] * cos(6.2830 * (c3[1] * cf + c4[1])));
-                nx = (384 + x) << 2;
-                ny = pitch * (256 + y);
-                pixels[ny + nx + 1] |= r;
-                pixels[ny + nx + 3] = 255;
-
-                r = 255 * (c1[0] + c2[0] * cos(6.2830 * (c3[0] * cf + c4[0])));
-                nx = (320 + x) << 2;
-                ny = pitch * (384 + y);
-                pixels[ny + nx] |= r;
-                pixels[ny + nx + 3] = 255;
-            }
-        }
-    }
-    SDL_UnlockTexture(texture);
-    SDL_RenderCopy(main_window, texture, NULL, &window_rec);
-}
-
-void show_palette()
-{
-    switch (pal)
-    {
-    case 0: // HSV
-        show_hsv_palette();
-        break;
-    case 1: // RGB
-        show_rgb_palette1();
-        break;
-    case 2: // RGB
-        show_rgb_palette2();
-        break;
-    }
-    SDL_RenderPresent(main_window);
-}
-
-void make_postprocess(void* px1)
-{
-    int i;
-
-    unsigned int* src = px1;
-    unsigned int* dst = texture_pixels;
-
-    int s = IMAGE_SIZE / 4;
-    for (i = 0; i < s; i++)
-    {
-        unsigned char r = 255.0 * src[i] / max_iter;
-        unsigned char g = 128 + 127 * sin(src[i]);
-        unsigned char b = 128 + 127 * cos(src[i]);
-        dst[i] = 0xff000000 | r << 16 | g << 8 | b;
-    }
+    return 0xff000000 | r << 16 | g << 8 | b;
 }
@@ -15,9 +15,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "gui.h"
 #include "parameters.h"
-#include "window.h"
-#include <SDL.h>
 
 FP_TYPE zx = 1.0, zy = 1.0; // zoom x, y
 FP_TYPE zoom = 1.0f;
@@ -29,8 +28,8 @@ unsigned int rgb;
 unsigned int mm = 1;
 int postprocess;
 
-int gws_x = WIDTH / 4;
-int gws_y = HEIGHT / 4;
+int gws_x = DEFAULT_WIDTH / 4;
+int gws_y = DEFAULT_HEIGHT / 4;
 
 #if 0
 FP_TYPE ofs_lx = -0.7402f;//-1.5f; //0.094; //-1.5f;
@@ -68,16 +67,11 @@ unsigned long long iter_limit = 43000000000000LL;
 unsigned long render_time;
 unsigned long render_times;
 unsigned long flips;
-unsigned long cpu_execution;
 unsigned long cpu_executions, gpu_executions;
 unsigned long cpu_iter, gpu_iter;
 int color_channel; // r, g, b
+struct render_ctx window_ctx;
 extern int quiet;
-extern void draw_box(int x, int y, int w, int h, int r, int g, int b);
-
-#ifdef OPENCL_SUPPORT
-extern void clear_pixels_ocl();
-#endif
 
 int calculate_offsets()
 {
@@ -103,6 +97,15 @@ int calculate_offsets()
         return 0;
 }
 
+// bounds of current view shown in panel and used to map position of mouse
+void update_bounds()
+{
+    lx = (ofs_lx + dx) / szx;
+    rx = (ofs_rx + dx) / szx;
+    ty = (ofs_ty + dy) / szy;
+    by = (ofs_by + dy) / szy;
+}
+
 void clear_counters()
 {
     cpu_iter = 0;
@@ -135,8 +138,8 @@ void set_fractal(enum fractals f, int d)
 {
     if (!quiet) printf("select fractal: %d\n", f);
     fractal = f;
-    gws_x = WIDTH / d;
-    gws_y = HEIGHT / d;
+    gws_x = frame_width / d;
+    gws_y = frame_height / d;
     init_parameters();
     clear_counters();
 }
@@ -192,9 +195,6 @@ void select_fractals(int k)
         break;
     case SDLK_F4:
         select_fractal(DRAGON);
-#ifdef OPENCL_SUPPORT
-        clear_pixels_ocl();
-#endif
         break;
     case SDLK_F5:
         select_fractal(JULIA3);
@@ -270,9 +270,9 @@ void change_fractal_params(int kl, int mod_kl)
         break;
         /*    case '2':
                 gws_x *= 2;
-                if (gws_x > WIDTH) gws_x = WIDTH;
+                if (gws_x > frame_width) gws_x = frame_width;
                 gws_y *= 2;
-                if (gws_y > HEIGHT) gws_y = HEIGHT;
+                if (gws_y > frame_height) gws_y = frame_height;
                 printf("gws: x=%d y=%d\n", gws_x, gws_y);
                 clear_counters();
                 break;
@@ -334,7 +334,7 @@ void change_fractal_colors(int kl, int mod_kl)
         {
             pal++;
             if (pal == 3) pal = 0;
-            draw_box(WIDTH, 0, RIGTH_PANEL_WIDTH, HEIGHT, 0, 0, 60);
+            draw_box(frame_width, 0, RIGTH_PANEL_WIDTH, frame_height, 0, 0, 60);
         }
         break;
     case 'h':
@@ -0,0 +1,656 @@
+/*
+    Copyright (C) 2018-2019  Jacek Danecki <jacek.m.danecki@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef OPENCL_SUPPORT
+#include "fractal_ocl.h"
+#else
+#include "fractal.h"
+#endif
+
+#include "kernels/burning_ship.cl"
+#include "kernels/common.cl"
+#include "kernels/dragon.cl"
+#include "kernels/generalized_celtic.cl"
+#include "kernels/julia.cl"
+#include "kernels/julia3.cl"
+#include "kernels/julia_full.cl"
+#include "kernels/mandelbrot.cl"
+#include "kernels/tricorn.cl"
+
+#include "palette.h"
+#include "render.h"
+#include "timer.h"
+#include <string.h>
+#include <unistd.h>
+
+#define COLOR_THREADS 16
+#define COLOR_MIN_PIXELS 65536 // smaller regions are colored by calling thread
+#define HISTOGRAM_MIN_BINS 65536        // smaller histograms are summed and scanned by one thread
+#define HISTOGRAM_MAX_COUNTERS (1 << 24) // counters of histograms of all threads
+
+int quiet;
+
+struct cpu_args
+{
+    int xs, xe, ys, ye;
+    struct render_ctx* ctx;
+    struct KERNEL_ARGS* args; // arguments of current pass shared read only by all threads
+};
+
+/* histogram of iterations, every thread counts iterations of its rows in own histogram, then bins are split
+   between threads, they sum histograms of all threads and for equalization scan their ranges with offsets of previous ranges */
+struct histogram_args
+{
+    const char* src;
+    int src_pitch;
+    int width;
+    int ys, ye;                   // rows counted by thread
+    unsigned int* hist;           // histogram of thread
+    unsigned int** hists;         // histograms of all counting threads, sums are stored in the first one
+    int threads;                  // counting threads
+    unsigned int bins;            // max_iter + 1, the last bin counts points inside of set
+    unsigned int b1, b2;          // range of bins summed and scanned by thread
+    unsigned long below;          // pixels in range of bins, then pixels in bins before range
+    unsigned long escaped;        // pixels with less than max_iter iterations
+    const unsigned int* palette;  // palette table
+    unsigned int* table;          // palette table remapped by histogram
+};
+
+// rows [ys, ye) of region colored by one thread
+struct color_args
+{
+    struct view* v;
+    const unsigned int* table; // NULL - palette is calculated for every pixel
+    unsigned int table_size;
+    const char* src;
+    int src_pitch;
+    char* dst;
+    int dst_pitch;
+    int width;
+    int ys, ye;
+};
+
+void kernel_args_from_view(struct view* v, struct KERNEL_ARGS* args)
+{
+    int c;
+
+    FP_TYPE ofs_lx1 = (v->ofs_lx + v->dx) / v->szx;
+    FP_TYPE ofs_rx1 = (v->ofs_rx + v->dx) / v->szx;
+    FP_TYPE ofs_ty1 = (v->ofs_ty + v->dy) / v->szy;
+    FP_TYPE ofs_by1 = (v->ofs_by + v->dy) / v->szy;
+
+    args->ofs_lx = ofs_lx1;
+    args->ofs_rx = v->ofs_rx;
+    args->ofs_ty = ofs_ty1;
+    args->ofs_by = v->ofs_by;
+
+    args->step_x = (ofs_rx1 - ofs_lx1) / v->width;
+    args->step_y = (ofs_by1 - ofs_ty1) / v->height;
+    args->width = v->width;
+    args->height = v->height;
+    args->stride = v->width;
+
+    args->rgb = v->rgb;
+    args->mm = v->mm;
+    args->er = v->er;
+    args->max_iter = v->max_iter;
+    args->mod1 = v->mod1;
+    args->pal = v->pal;
+    args->c_x = v->c_x;
+    args->c_y = v->c_y;
+    args->post_process = v->postprocess;
+
+    for (c = 0; c < 3; c++)
+    {
+        args->c1[c] = v->c1[c];
+        args->c2[c] = v->c2[c];
+        args->c3[c] = v->c3[c];
+        args->c4[c] = v->c4[c];
+    }
+}
+
+#ifdef FP_64_SUPPORT
+void kernel_args32_from_view(struct view* v, struct kernel_args32* args)
+{
+    float ofs_lx1, ofs_rx1, ofs_ty1, ofs_by1;
+    int c;
+
+    ofs_lx1 = (v->ofs_lx + v->dx) / v->szx;
+    ofs_rx1 = (v->ofs_rx + v->dx) / v->szx;
+    ofs_ty1 = (v->ofs_ty + v->dy) / v->szy;
+    ofs_by1 = (v->ofs_by + v->dy) / v->szy;
+    args->ofs_lx = ofs_lx1;
+    args->ofs_rx = v->ofs_rx;
+    args->ofs_ty = ofs_ty1;
+    args->ofs_by = v->ofs_by;
+
+    args->step_x = (ofs_rx1 - ofs_lx1) / v->width;
+    args->step_y = (ofs_by1 - ofs_ty1) / v->height;
+    args->width = v->width;
+    args->height = v->height;
+    args->stride = v->width;
+
+    args->rgb = v->rgb;
+    args->mm = v->mm;
+    args->er = v->er;
+    args->max_iter = v->max_iter;
+    args->mod1 = v->mod1;
+    args->pal = v->pal;
+    args->c_x = v->c_x;
+    args->c_y = v->c_y;
+    args->post_process = v->postprocess;
+
+    for (c = 0; c < 3; c++)
+    {
+        args->c1[c] = v->c1[c];
+        args->c2[c] = v->c2[c];
+        args->c3[c] = v->c3[c];
+        args->c4[c] = v->c4[c];
+    }
+}
+#endif
+
+// next of 16 interleaved sub-frames
+void next_subframe(int* ofs_x, int* ofs_y)
+{
+    (*ofs_x)++;
+    if (*ofs_x == 4)
+    {
+        (*ofs_y)++;
+        *ofs_x = 0;
+    }
+    if (*ofs_y == 4)
+    {
+        *ofs_x = 0;
+        *ofs_y = 0;
+    }
+}
+
+unsigned int calculate_pixel(struct render_ctx* ctx, enum fractals f, struct KERNEL_ARGS* args, int x, int y)
+{
+    switch (f)
+    {
+    case JULIA:
+        return julia(args->ofs_x + x * 4, args->ofs_y + y * 4, ctx->pixels, ctx->colors, *args);
+
+    case JULIA3:
+        return julia3(args->ofs_x + x * 4, args->ofs_y + y * 4, ctx->pixels, ctx->colors, *args);
+
+    case JULIA_FULL:
+        return julia_full(x, y, ctx->pixels, ctx->colors, *args);
+
+    case MANDELBROT:
+        return mandelbrot(args->ofs_x + x * 4, args->ofs_y + y * 4, ctx->pixels, ctx->colors, *args);
+
+    case BURNING_SHIP:
+        return burning_ship(args->ofs_x + x * 4, args->ofs_y + y * 4, ctx->pixels, ctx->colors, *args);
+
+    case GENERALIZED_CELTIC:
+        return generalized_celtic(args->ofs_x + x * 4, args->ofs_y + y * 4, ctx->pixels, ctx->colors, *args);
+
+    case TRICORN:
+        return tricorn(args->ofs_x + x * 4, args->ofs_y + y * 4, ctx->pixels, ctx->colors, *args);
+
+    default:
+        return 0;
+    }
+}
+
+void* execute_fractal_cpu(void* c)
+{
+    int x, y;
+    struct cpu_args* cpu = (struct cpu_args*)c;
+    struct render_ctx* ctx = cpu->ctx;
+
+    for (y = cpu->ys; y < cpu->ye && !frame_cancelled(ctx); y++)
+    {
+        for (x = cpu->xs; x < cpu->xe; x++)
+        {
+            calculate_pixel(ctx, ctx->view.fractal, cpu->args, x, y);
+        }
+    }
+    return NULL;
+}
+
+void start_cpu(struct render_ctx* ctx)
+{
+    unsigned long tp1, tp2;
+    int t;
+
+    tp1 = get_time_usec();
+
+    struct KERNEL_ARGS args = ctx->view.args;
+    int frame;
+    for (frame = 0; frame < ctx->view.draw_frames && !frame_cancelled(ctx); frame++)
+    {
+        next_subframe(&ctx->cpu_ofs_x, &ctx->cpu_ofs_y);
+        args.ofs_x = ctx->cpu_ofs_x;
+        args.ofs_y = ctx->cpu_ofs_y;
+
+        if (ctx->view.fractal == DRAGON)
+        {
+            memset(ctx->pixels, 0, FRAME_SIZE(&ctx->view));
+            dragon(0, 0, ctx->pixels, ctx->colors, args);
+        }
+        else
+        {
+            struct cpu_args t_args[16];
+            pthread_t tid[16];
+
+            // 4x4 blocks of global work size
+            for (t = 0; t < 16; t++)
+            {
+                t_args[t].xs = ctx->view.gws_x * (t % 4) / 4;
+                t_args[t].xe = ctx->view.gws_x * (t % 4 + 1) / 4;
+                t_args[t].ys = ctx->view.gws_y * (t / 4) / 4;
+                t_args[t].ye = ctx->view.gws_y * (t / 4 + 1) / 4;
+                t_args[t].ctx = ctx;
+                t_args[t].args = &args;
+            }
+            for (t = 0; t < 16; t++)
+            {
+                pthread_create(&tid[t], NULL, execute_fractal_cpu, &t_args[t]);
+            }
+            for (t = 0; t < 16; t++)
+            {
+                pthread_join(tid[t], NULL);
+            }
+        }
+    }
+    tp2 = get_time_usec();
+    ctx->cpu_execution = tp2 - tp1;
+}
+
+// kernel arguments of view in both precisions, called once for every frame
+void view_kernel_args(struct view* v)
+{
+    kernel_args_from_view(v, &v->args);
+#ifdef FP_64_SUPPORT
+    kernel_args32_from_view(v, &v->args32);
+#else
+    v->args32 = v->args;
+#endif
+}
+
+int get_tile(struct render_ctx* ctx, int* start, int* end)
+{
+    int t = __atomic_fetch_add(&ctx->next_tile, 1, __ATOMIC_RELAXED);
+
+    if (t >= ctx->nr_tiles) return 0;
+    *start = t * TILE_ROWS;
+    *end = *start + TILE_ROWS;
+    if (*end > ctx->view.gws_y) *end = ctx->view.gws_y;
+    return 1;
+}
+
+void set_subframe(struct render_ctx* ctx, int frame, int* ofs_x, int* ofs_y)
+{
+    int phase = (ctx->tile_phase + frame + 1) % 16;
+
+    *ofs_x = phase % 4;
+    *ofs_y = phase / 4;
+}
+
+void tile_done(struct render_ctx* ctx, enum backends b, int pixels) { __atomic_fetch_add(&ctx->tile_pixels[b], pixels, __ATOMIC_RELAXED); }
+
+// view of calculated frame was replaced by newer one, workers stop between passes, tiles and rows
+int frame_cancelled(struct render_ctx* ctx)
+{
+    return ctx->generation && __atomic_load_n(ctx->generation, __ATOMIC_RELAXED) != ctx->view.generation;
+}
+
+#ifdef OPENCL_SUPPORT
+int use_hybrid(struct view* v) { return v->hybrid && __atomic_load_n(&ocl_state, __ATOMIC_ACQUIRE) == OCL_READY && v->fractal != DRAGON; }
+
+void* execute_tiles_cpu(void* c)
+{
+    struct render_ctx* ctx = (struct render_ctx*)c;
+    struct KERNEL_ARGS args = ctx->view.args;
+    int start, end, frame, x, y;
+
+    while (!frame_cancelled(ctx) && get_tile(ctx, &start, &end))
+    {
+        for (frame = 0; frame < ctx->view.draw_frames; frame++)
+        {
+            set_subframe(ctx, frame, &args.ofs_x, &args.ofs_y);
+            for (y = start; y < end; y++)
+            {
+                for (x = 0; x < ctx->view.gws_x; x++)
+                {
+                    calculate_pixel(ctx, ctx->view.fractal, &args, x, y);
+                }
+            }
+        }
+        tile_done(ctx, BACKEND_CPU, (end - start) * ctx->view.gws_x * ctx->view.draw_frames);
+    }
+    return NULL;
+}
+
+void start_hybrid(struct render_ctx* ctx)
+{
+    unsigned long tp1, tp2;
+    int t, b, tasks, threads;
+    pthread_t tid[64];
+
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > 64) threads = 64;
+
+    ctx->nr_tiles = (ctx->view.gws_y + TILE_ROWS - 1) / TILE_ROWS;
+    ctx->next_tile = 0;
+    for (b = 0; b < NR_BACKENDS; b++) ctx->tile_pixels[b] = 0;
+
+    tp1 = get_time_usec();
+    tasks = start_tiles_ocl(ctx);
+    for (t = 0; t < threads; t++)
+    {
+        pthread_create(&tid[t], NULL, execute_tiles_cpu, ctx);
+    }
+    for (t = 0; t < threads; t++)
+    {
+        pthread_join(tid[t], NULL);
+    }
+    if (tasks) wait_for_devices(&ctx->view);
+    tp2 = get_time_usec();
+
+    ctx->tile_phase = (ctx->tile_phase + ctx->view.draw_frames) % 16;
+    ctx->ocl_execution = (tp2 - tp1) / ctx->view.draw_frames;
+    for (b = 0; b < NR_BACKENDS; b++)
+    {
+        ctx->backend_pps[b] = tp2 > tp1 ? 1000000.0 * ctx->tile_pixels[b] / (tp2 - tp1) : 0;
+    }
+}
+#else
+int use_hybrid(struct view* v) { return 0; }
+#endif
+
+// color of i iterations in postprocess mode or in palette
+unsigned int pixel_color(struct KERNEL_ARGS* a, unsigned int i)
+{
+    if (a->post_process) return postprocess_color(i, a->max_iter);
+    return set_color(*a, i, colors);
+}
+
+int same_palette(const struct KERNEL_ARGS* a, const struct KERNEL_ARGS* b)
+{
+    if (a->post_process != b->post_process) return 0;
+    if (a->post_process) return a->max_iter == b->max_iter;
+    if (a->pal != b->pal || a->mm != b->mm || a->rgb != b->rgb || a->max_iter != b->max_iter) return 0;
+    if (a->pal != 2) return 1;
+    return !memcmp(a->c1, b->c1, sizeof(a->c1)) && !memcmp(a->c2, b->c2, sizeof(a->c2)) && !memcmp(a->c3, b->c3, sizeof(a->c3)) &&
+           !memcmp(a->c4, b->c4, sizeof(a->c4));
+}
+
+// table of max_iter + 1 colors is built by pixel_color, so it has the same colors as pixels colored one by one
+void build_palette(struct KERNEL_ARGS* a, unsigned int* table)
+{
+    unsigned int i;
+
+    for (i = 0; i <= a->max_iter; i++) table[i] = pixel_color(a, i);
+}
+
+int update_palette_table(struct palette_table* pt, struct KERNEL_ARGS* a)
+{
+    unsigned int* table;
+
+    if (pt->colors && same_palette(a, &pt->args)) return 0;
+    if (a->max_iter >= PALETTE_MAX_COLORS) return 1;
+    table = realloc(pt->colors, (a->max_iter + 1) * sizeof(unsigned int));
+    if (!table) return 1;
+    build_palette(a, table);
+    pt->colors = table;
+    pt->size = a->max_iter + 1;
+    pt->args = *a;
+    return 0;
+}
+
+void release_palette_table(struct palette_table* pt)
+{
+    free(pt->colors);
+    pt->colors = NULL;
+}
+
+// colors of n pixels, one load from table for every pixel, numbers of iterations above max_iter aren't in table
+void color_pixels(struct color_args* c, const unsigned int* restrict src, unsigned int* restrict dst, int n)
+{
+    struct KERNEL_ARGS* a = &c->v->args;
+    const unsigned int* restrict table = c->table;
+    unsigned int size = c->table_size;
+    int i, outside = 0;
+
+    if (!table)
+    {
+        for (i = 0; i < n; i++) dst[i] = pixel_color(a, src[i]);
+        return;
+    }
+    // loop without calls can be vectorized, rare pixels outside of table are colored again
+    for (i = 0; i < n; i++)
+    {
+        int in = src[i] < size;
+
+        dst[i] = table[src[i] & -in];
+        outside |= !in;
+    }
+    if (!outside) return;
+    for (i = 0; i < n; i++)
+        if (src[i] >= size) dst[i] = pixel_color(a, src[i]);
+}
+
+// fn is called for every element of args, by calling thread if there is only one
+void run_threads(void* (*fn)(void*), void* args, size_t size, int threads)
+{
+    pthread_t tid[COLOR_THREADS];
+    int t;
+
+    if (threads == 1)
+    {
+        fn(args);
+        return;
+    }
+    for (t = 0; t < threads; t++) pthread_create(&tid[t], NULL, fn, (char*)args + t * size);
+    for (t = 0; t < threads; t++) pthread_join(tid[t], NULL);
+}
+
+void* count_iterations_thread(void* p)
+{
+    struct histogram_args* e = p;
+    unsigned int last = e->bins - 1;
+    int x, y;
+
+    memset(e->hist, 0, e->bins * sizeof(unsigned int));
+    for (y = e->ys; y < e->ye; y++)
+    {
+        const unsigned int* src = (const unsigned int*)(e->src + (size_t)y * e->src_pitch);
+
+        for (x = 0; x < e->width; x++) e->hist[src[x] < last ? src[x] : last]++;
+    }
+    return NULL;
+}
+
+void* sum_histograms_thread(void* p)
+{
+    struct histogram_args* e = p;
+    unsigned int i, sum;
+    int t;
+
+    e->below = 0;
+    for (i = e->b1; i < e->b2; i++)
+    {
+        for (sum = 0, t = 0; t < e->threads; t++) sum += e->hists[t][i];
+        e->hists[0][i] = sum;
+        e->below += sum;
+    }
+    return NULL;
+}
+
+// colors of palette are spread by cumulative histogram, points inside of set keep their color
+void* remap_palette_thread(void* p)
+{
+    struct histogram_args* e = p;
+    unsigned long below = e->below;
+    unsigned int i, last = e->bins - 1;
+
+    for (i = e->b1; i < e->b2; i++)
+    {
+        e->table[i] = i == last || !e->escaped ? e->palette[i] : e->palette[below * last / e->escaped];
+        below += e->hists[0][i];
+    }
+    return NULL;
+}
+
+/* histogram of region is summed in the first histogram of threads, it has to be freed by caller,
+   returns number of threads which summed ranges of bins, 0 if there is no memory for histograms */
+int count_histogram(struct histogram_args* e, unsigned int** hists, unsigned int bins, const void* src, int src_pitch, int width, int nr_rows)
+{
+    unsigned int* counters;
+    int t, scan_threads, threads = (size_t)width * nr_rows >= COLOR_MIN_PIXELS ? COLOR_THREADS : 1;
+
+    while (threads > 1 && (size_t)threads * bins > HISTOGRAM_MAX_COUNTERS) threads /= 2;
+    scan_threads = bins >= HISTOGRAM_MIN_BINS ? threads : 1;
+    counters = malloc((size_t)threads * bins * sizeof(unsigned int));
+    if (!counters) return 0;
+    for (t = 0; t < threads; t++) hists[t] = counters + (size_t)t * bins;
+    for (t = 0; t < threads; t++)
+    {
+        e[t].src = src;
+        e[t].src_pitch = src_pitch;
+        e[t].width = width;
+        e[t].ys = nr_rows * t / threads;
+        e[t].ye = nr_rows * (t + 1) / threads;
+        e[t].hist = hists[t];
+        e[t].hists = hists;
+        e[t].threads = threads;
+        e[t].bins = bins;
+        e[t].b1 = (unsigned long)bins * t / scan_threads;
+        e[t].b2 = (unsigned long)bins * (t + 1) / scan_threads;
+    }
+    run_threads(count_iterations_thread, e, sizeof(e[0]), threads);
+    run_threads(sum_histograms_thread, e, sizeof(e[0]), scan_threads);
+    return scan_threads;
+}
+
+// numbers of iterations of region smaller than bins - 1, bigger ones are counted in the last bin
+int histogram_rows(const void* src, int src_pitch, int width, int nr_rows, unsigned int* hist, unsigned int bins)
+{
+    struct histogram_args e[COLOR_THREADS];
+    unsigned int* hists[COLOR_THREADS];
+
+    if (!count_histogram(e, hists, bins, src, src_pitch, width, nr_rows)) return 1;
+    memcpy(hist, hists[0], bins * sizeof(unsigned int));
+    free(hists[0]);
+    return 0;
+}
+
+/* palette table remapped so that every color covers similar number of pixels of region,
+   returns NULL if there is no memory for histograms */
+unsigned int* equalize_palette(const unsigned int* palette, unsigned int bins, const void* src, int src_pitch, int width, int nr_rows)
+{
+    struct histogram_args e[COLOR_THREADS];
+    unsigned int* hists[COLOR_THREADS];
+    unsigned int* table;
+    unsigned long below = 0;
+    int t, scan_threads;
+
+    scan_threads = count_histogram(e, hists, bins, src, src_pitch, width, nr_rows);
+    if (!scan_threads) return NULL;
+    table = malloc(bins * sizeof(unsigned int));
+    if (!table)
+    {
+        free(hists[0]);
+        return NULL;
+    }
+    // sums of ranges become offsets of ranges
+    for (t = 0; t < scan_threads; t++)
+    {
+        unsigned long sum = e[t].below;
+
+        e[t].below = below;
+        below += sum;
+    }
+    for (t = 0; t < scan_threads; t++)
+    {
+        e[t].escaped = below - hists[0][bins - 1];
+        e[t].palette = palette;
+        e[t].table = table;
+    }
+    run_threads(remap_palette_thread, e, sizeof(e[0]), scan_threads);
+    free(hists[0]);
+    return table;
+}
+
+void* color_rows_thread(void* p)
+{
+    struct color_args* c = p;
+    int y;
+
+    for (y = c->ys; y < c->ye; y++)
+    {
+        const void* src = c->src + (size_t)y * c->src_pitch;
+        void* dst = c->dst + (size_t)y * c->dst_pitch;
+
+        // dragon is drawn with colors
+        if (c->v->fractal == DRAGON)
+            memcpy(dst, src, c->width * BPP);
+        else
+            color_pixels(c, src, dst, c->width);
+    }
+    return NULL;
+}
+
+/* coloring pass, numbers of iterations calculated by kernels are mapped to colors of palette of view,
+   so palette can be changed without calculation of frame, big regions are split between threads.
+   Palette table pt is rebuilt when palette of view changes, it's used by one thread at a time, so every
+   context has own table. Equalized palette depends on histogram of region, so whole frame should be colored at once */
+void color_rows(struct palette_table* pt, struct view* v, const void* src, int src_pitch, void* dst, int dst_pitch, int width, int nr_rows)
+{
+    struct color_args c[COLOR_THREADS];
+    int t, threads = (size_t)width * nr_rows >= COLOR_MIN_PIXELS ? COLOR_THREADS : 1;
+    unsigned int* table = NULL;
+    unsigned int* equalized = NULL;
+
+    if (v->fractal != DRAGON && !update_palette_table(pt, &v->args)) table = pt->colors;
+    if (table && v->equalize) equalized = equalize_palette(table, pt->size, src, src_pitch, width, nr_rows);
+    if (equalized) table = equalized;
+    for (t = 0; t < threads; t++)
+    {
+        c[t].v = v;
+        c[t].table = table;
+        c[t].table_size = pt->size;
+        c[t].src = src;
+        c[t].src_pitch = src_pitch;
+        c[t].dst = dst;
+        c[t].dst_pitch = dst_pitch;
+        c[t].width = width;
+        c[t].ys = nr_rows * t / threads;
+        c[t].ye = nr_rows * (t + 1) / threads;
+    }
+    run_threads(color_rows_thread, c, sizeof(c[0]), threads);
+    free(equalized);
+}
+
+// calculate frame described by view of context, buffers of OCL devices are swapped by caller
+void calculate_frame(struct render_ctx* ctx)
+{
+#ifdef OPENCL_SUPPORT
+    if (use_hybrid(&ctx->view))
+        start_hybrid(ctx);
+    else if (ctx->view.cur_dev)
+        finish_ocl(ctx, signal_ocl(ctx));
+    else
+#endif
+        start_cpu(ctx);
+}
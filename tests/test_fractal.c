@@ -69,8 +69,8 @@ void* execute_fractal(void* p)
             double z_x, z_y;
             unsigned int c = 0;
 
-            z_x = lx + size * x / WIDTH;
-            z_y = ty - size * y / HEIGHT;
+            z_x = lx + size * x / DEFAULT_WIDTH;
+            z_y = ty - size * y / DEFAULT_HEIGHT;
 
             c = get_iter(z_x, z_y);
             if (c < (max_iter - 1) && c > args->max_iter)
@@ -79,7 +79,7 @@ void* execute_fractal(void* p)
                 args->max_iter_x = z_x;
                 args->max_iter_y = z_y;
             }
-            pixels[y * WIDTH + x] = c;
+            pixels[y * DEFAULT_WIDTH + x] = c;
         }
     }
     return NULL;
@@ -94,7 +94,7 @@ int main()
     unsigned long tp1, tp2, tp3, avg;
     int fin = 0;
 
-    if (posix_memalign((void**)&pixels, 4096, IMAGE_SIZE)) return 1;
+    if (posix_memalign((void**)&pixels, 4096, (DEFAULT_WIDTH * DEFAULT_HEIGHT * BPP))) return 1;
 
     init_window();
 
@@ -109,8 +109,8 @@ int main()
 
     SDL_Rect window_rec;
 
-    window_rec.w = WIDTH;
-    window_rec.h = HEIGHT;
+    window_rec.w = DEFAULT_WIDTH;
+    window_rec.h = DEFAULT_HEIGHT;
     window_rec.x = 0;
     window_rec.y = 0;
 
@@ -118,21 +118,21 @@ int main()
 
     memset(args, 0, sizeof(args));
 
-    args[0].xe = WIDTH / 2;
-    args[0].ye = HEIGHT / 2;
+    args[0].xe = DEFAULT_WIDTH / 2;
+    args[0].ye = DEFAULT_HEIGHT / 2;
 
-    args[1].xs = WIDTH / 2;
-    args[1].xe = WIDTH;
-    args[1].ye = HEIGHT / 2;
+    args[1].xs = DEFAULT_WIDTH / 2;
+    args[1].xe = DEFAULT_WIDTH;
+    args[1].ye = DEFAULT_HEIGHT / 2;
 
-    args[2].xe = WIDTH / 2;
-    args[2].ys = HEIGHT / 2;
-    args[2].ye = HEIGHT;
+    args[2].xe = DEFAULT_WIDTH / 2;
+    args[2].ys = DEFAULT_HEIGHT / 2;
+    args[2].ye = DEFAULT_HEIGHT;
 
-    args[3].xs = WIDTH / 2;
-    args[3].xe = WIDTH;
-    args[3].ys = HEIGHT / 2;
-    args[3].ye = HEIGHT;
+    args[3].xs = DEFAULT_WIDTH / 2;
+    args[3].xe = DEFAULT_WIDTH;
+    args[3].ys = DEFAULT_HEIGHT / 2;
+    args[3].ye = DEFAULT_HEIGHT;
 
     pthread_t tid[THREADS];
     while (!fin)
@@ -191,7 +191,7 @@ int main()
             }
             if (event.type == SDL_MOUSEMOTION)
             {
-                if (event.button.x > WIDTH) continue;
+                if (event.button.x > DEFAULT_WIDTH) continue;
                 mx = event.button.x;
                 my = event.button.y;
                 redraw = 1;
@@ -199,10 +199,10 @@ int main()
             }
             if (event.type == SDL_MOUSEBUTTONDOWN)
             {
-                if (event.button.x > WIDTH) continue;
+                if (event.button.x > DEFAULT_WIDTH) continue;
 
-                px = lx + size * mx / WIDTH;
-                py = ty - size * my / HEIGHT;
+                px = lx + size * mx / DEFAULT_WIDTH;
+                py = ty - size * my / DEFAULT_HEIGHT;
 
                 if (event.button.button == 2)
                 {
@@ -237,46 +237,46 @@ int main()
 
             tp2 = get_time_usec();
 
-            SDL_UpdateTexture(texture, NULL, pixels, WIDTH * 4);
+            SDL_UpdateTexture(texture, NULL, pixels, DEFAULT_WIDTH * 4);
             SDL_RenderCopy(main_window, texture, NULL, &window_rec);
 
             int ry = 0;
 
             sprintf(status_line, "x:%1.20f ", px);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "y:%1.20f ", py);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "size:%f ", size);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             if (mouse_move)
             {
-                px = lx + size * mx / WIDTH;
-                py = ty - size * my / HEIGHT;
+                px = lx + size * mx / DEFAULT_WIDTH;
+                py = ty - size * my / DEFAULT_HEIGHT;
                 iter = get_iter(px, py);
                 sprintf(status_line, "iter=%d ", iter);
-                write_text(status_line, WIDTH, ry);
+                write_text(status_line, DEFAULT_WIDTH, ry);
                 ry += FONT_SIZE;
 
                 for (int t = 0; t < THREADS; t++)
                 {
                     sprintf(status_line, "max[%d]:%d/%d ", t, args[t].max_iter, max_iter);
-                    write_text(status_line, WIDTH, ry);
+                    write_text(status_line, DEFAULT_WIDTH, ry);
                     printf(status_line);
                     ry += FONT_SIZE;
 
                     sprintf(status_line, "%1.20f ", args[t].max_iter_x);
-                    write_text(status_line, WIDTH, ry);
+                    write_text(status_line, DEFAULT_WIDTH, ry);
                     printf(status_line);
                     ry += FONT_SIZE;
 
                     sprintf(status_line, "%1.20f ", args[t].max_iter_y);
-                    write_text(status_line, WIDTH, ry);
+                    write_text(status_line, DEFAULT_WIDTH, ry);
                     printf("%s\n", status_line);
                     ry += FONT_SIZE;
                 }
@@ -284,48 +284,48 @@ int main()
             avg = i ? render_times / i : 0;
 
             sprintf(status_line, "exec=%lu ", exec_time);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "render=%lu avg=%lu ", render_time, avg);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "lx:%1.20f ", lx);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "rx:%1.20f ", lx + size);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "cx:%1.20f ", cx);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "ty:%1.20f ", ty);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "by:%1.20f ", ty - size);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "cy:%1.20f ", cy);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "size:%1.20f ", size);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "zoom:%1.20f ", size < 1 ? 1 / size : size);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             SDL_SetRenderDrawColor(main_window, 255, 255, 255, SDL_ALPHA_OPAQUE);
-            SDL_RenderDrawLine(main_window, 0, HEIGHT / 2, WIDTH, HEIGHT / 2);
-            SDL_RenderDrawLine(main_window, WIDTH / 2, 0, WIDTH / 2, HEIGHT);
+            SDL_RenderDrawLine(main_window, 0, DEFAULT_HEIGHT / 2, DEFAULT_WIDTH, DEFAULT_HEIGHT / 2);
+            SDL_RenderDrawLine(main_window, DEFAULT_WIDTH / 2, 0, DEFAULT_WIDTH / 2, DEFAULT_HEIGHT);
 
             SDL_RenderPresent(main_window);
 
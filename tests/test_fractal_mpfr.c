@@ -32,7 +32,7 @@ unsigned int m = 16;
 #define THREADS 12
 
 int hy = 32;
-int h = HEIGHT / 2;
+int h = DEFAULT_HEIGHT / 2;
 
 struct t_pars
 {
@@ -94,7 +94,7 @@ void* execute_fractal(void* par)
     mpfr_init2(d, res);
     mpfr_init2(l_z_y, res);
 
-    int w = WIDTH / 2;
+    int w = DEFAULT_WIDTH / 2;
 
     struct t_pars* t = (struct t_pars*)par;
 
@@ -131,7 +131,7 @@ void* execute_fractal(void* par)
             //   args->max_iter_x = z_x;
             // args->max_iter_y = z_y;
         }
-        pixels[(hy * t->tid + t->y) * WIDTH + x] = c * m;
+        pixels[(hy * t->tid + t->y) * DEFAULT_WIDTH + x] = c * m;
     }
     t->y++;
     if (t->y == hy) t->y = 0;
@@ -159,7 +159,7 @@ int main()
     unsigned long tp1, tp2, tp3, avg;
     int fin = 0;
 
-    if (posix_memalign((void**)&pixels, 4096, IMAGE_SIZE)) return 1;
+    if (posix_memalign((void**)&pixels, 4096, (DEFAULT_WIDTH * DEFAULT_HEIGHT * BPP))) return 1;
 
     init_window();
 
@@ -174,8 +174,8 @@ int main()
 
     SDL_Rect window_rec;
 
-    window_rec.w = WIDTH;
-    window_rec.h = HEIGHT;
+    window_rec.w = DEFAULT_WIDTH;
+    window_rec.h = DEFAULT_HEIGHT;
     window_rec.x = 0;
     window_rec.y = 0;
 
@@ -275,7 +275,7 @@ int main()
             }
             if (event.type == SDL_MOUSEMOTION)
             {
-                if (event.button.x > WIDTH) continue;
+                if (event.button.x > DEFAULT_WIDTH) continue;
                 // mx = event.button.x;
                 // my = event.button.y;
                 redraw = 1;
@@ -284,10 +284,10 @@ int main()
             }
             if (event.type == SDL_MOUSEBUTTONDOWN)
             {
-                if (event.button.x > WIDTH) continue;
+                if (event.button.x > DEFAULT_WIDTH) continue;
 
-                //                px = lx + size * mx / WIDTH;
-                //              py = ty - size * my / HEIGHT;
+                //                px = lx + size * mx / DEFAULT_WIDTH;
+                //              py = ty - size * my / DEFAULT_HEIGHT;
 
                 if (event.button.button == 2)
                 {
@@ -326,41 +326,41 @@ int main()
 
             tp2 = get_time_usec();
 
-            SDL_UpdateTexture(texture, NULL, pixels, WIDTH * 4);
+            SDL_UpdateTexture(texture, NULL, pixels, DEFAULT_WIDTH * 4);
             SDL_RenderCopy(main_window, texture, NULL, &window_rec);
 
             int ry = 0;
 
             /*         sprintf(status_line, "x:%1.20f ", px);
-                     write_text(status_line, WIDTH, ry);
+                     write_text(status_line, DEFAULT_WIDTH, ry);
                      ry += FONT_SIZE;
 
                      sprintf(status_line, "y:%1.20f ", py);
-                     write_text(status_line, WIDTH, ry);
+                     write_text(status_line, DEFAULT_WIDTH, ry);
                      ry += FONT_SIZE;
          */
             double s = mpfr_get_d(size, MPFR_RNDD);
             sprintf(status_line, "size:%0.17f ", s);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
             /*
                         if (mouse_move)
                         {
-                            px = lx + size * mx / WIDTH;
-                            py = ty - size * my / HEIGHT;
+                            px = lx + size * mx / DEFAULT_WIDTH;
+                            py = ty - size * my / DEFAULT_HEIGHT;
                             iter = get_iter(px, py);
                             sprintf(status_line, "iter=%d ", iter);
-                            write_text(status_line, WIDTH, ry);
+                            write_text(status_line, DEFAULT_WIDTH, ry);
                             ry += FONT_SIZE;
 
 
                                 sprintf(status_line, "%1.20f ", args.max_iter_x);
-                                write_text(status_line, WIDTH, ry);
+                                write_text(status_line, DEFAULT_WIDTH, ry);
             //                    printf(status_line);
                                 ry += FONT_SIZE;
 
                                 sprintf(status_line, "%1.20f ", args.max_iter_y);
-                                write_text(status_line, WIDTH, ry);
+                                write_text(status_line, DEFAULT_WIDTH, ry);
             //                    printf("%s\n", status_line);
                                 ry += FONT_SIZE;
                         }
@@ -372,60 +372,60 @@ int main()
             }
 
             sprintf(status_line, "max:%d/%d ", t_max_iter, max_iter);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             avg = i ? render_times / i : 0;
 
             sprintf(status_line, "exec=%lu ", exec_time);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "render=%lu avg=%lu ", render_time, avg);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "loops=%d ", loops);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             double l = mpfr_get_d(lx, MPFR_RNDD);
 
             sprintf(status_line, "lx:%1.18f ", l);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             /*            sprintf(status_line, "rx:%1.20f ", lx + size);
-                        write_text(status_line, WIDTH, ry);
+                        write_text(status_line, DEFAULT_WIDTH, ry);
                         ry += FONT_SIZE;
 
                         sprintf(status_line, "cx:%1.20f ", cx);
-                        write_text(status_line, WIDTH, ry);
+                        write_text(status_line, DEFAULT_WIDTH, ry);
                         ry += FONT_SIZE;
             */
             double t = mpfr_get_d(ty, MPFR_RNDD);
             sprintf(status_line, "ty:%1.18f ", t);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             sprintf(status_line, "m:%d ", m);
-            write_text(status_line, WIDTH, ry);
+            write_text(status_line, DEFAULT_WIDTH, ry);
             ry += FONT_SIZE;
 
             /*            sprintf(status_line, "by:%1.20f ", ty - size);
-                        write_text(status_line, WIDTH, ry);
+                        write_text(status_line, DEFAULT_WIDTH, ry);
                         ry += FONT_SIZE;
 
                         sprintf(status_line, "cy:%1.20f ", cy);
-                        write_text(status_line, WIDTH, ry);
+                        write_text(status_line, DEFAULT_WIDTH, ry);
                         ry += FONT_SIZE;
 
                         sprintf(status_line, "zoom:%1.20f ", size < 1 ? 1 / size : size);
-                        write_text(status_line, WIDTH, ry);
+                        write_text(status_line, DEFAULT_WIDTH, ry);
                         ry += FONT_SIZE;
 
-                        int fx = (args.max_iter_x - lx) * WIDTH / size;
-                        int fy = -(args.max_iter_y - ty) * HEIGHT / size;
+                        int fx = (args.max_iter_x - lx) * DEFAULT_WIDTH / size;
+                        int fy = -(args.max_iter_y - ty) * DEFAULT_HEIGHT / size;
 
                         SDL_SetRenderDrawColor(main_window, 255, 255, 255, SDL_ALPHA_OPAQUE);
                         SDL_RenderDrawLine(main_window, 0, 0, fx, fy);
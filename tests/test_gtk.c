@@ -39,8 +39,8 @@ static gboolean draw_cb(GtkWidget* widget, cairo_t* cr, gpointer data)
 #endif
     int w, h, stride;
 
-    w = window_width > WIDTH ? WIDTH : window_width;
-    h = window_height > HEIGHT ? HEIGHT : window_height;
+    w = window_width > DEFAULT_WIDTH ? DEFAULT_WIDTH : window_width;
+    h = window_height > DEFAULT_HEIGHT ? DEFAULT_HEIGHT : window_height;
 
     pix = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, w, h);
     pix_data = gdk_pixbuf_get_pixels(pix);
@@ -100,7 +100,7 @@ int main(int argc, char** argv)
     gtk_init(&argc, &argv);
 
     window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
-    gtk_widget_set_size_request(window, WIDTH, HEIGHT);
+    gtk_widget_set_size_request(window, DEFAULT_WIDTH, DEFAULT_HEIGHT);
 
     g_signal_connect(window, "destroy", G_CALLBACK(gtk_main_quit), NULL);
 
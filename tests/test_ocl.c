@@ -20,10 +20,9 @@
 #include "timer.h"
 
 int finish_thread;
-volatile int tasks_finished;
 int quiet;
 
-unsigned long execute_fractal(struct ocl_device* dev)
+unsigned long execute_test_kernel(struct ocl_device* dev)
 {
     char* name = test_fractal.name;
     cl_kernel kernel = dev->test_kernel;
@@ -55,27 +54,19 @@ void* ocl_kernel(void* d)
 {
     struct ocl_device* dev = (struct ocl_device*)d;
     struct ocl_thread* t = &dev->thread;
+    struct ocl_job job;
+    struct ocl_completion c;
     unsigned long exec_time = 0;
 
-    while (!finish_thread)
+    while (!take_job(t, &job))
     {
-        pthread_mutex_lock(&t->lock);
-        while (!t->work)
-        {
-            if (finish_thread)
-            {
-                printf("thread exits for %s\n", dev->name);
-                return NULL;
-            }
-            pthread_cond_wait(&t->cond, &t->lock);
-        }
-        t->work = 0;
-        pthread_mutex_unlock(&t->lock);
-
         printf("ocl kernel for %s tid=%lx\n", dev->name, dev->thread.tid);
 
-        exec_time = execute_fractal(dev);
-        tasks_finished++;
+        exec_time = execute_test_kernel(dev);
+        c.generation = job.generation;
+        c.err = !exec_time;
+        c.execution = exec_time;
+        post_completion(t, &c);
 
         if (!exec_time)
         {
@@ -96,23 +87,19 @@ void* ocl_kernel(void* d)
 
 int signal_device(struct ocl_device* dev)
 {
+    struct ocl_job job = {0};
+
     if (!dev->initialized) return 1;
     if (dev->thread.finished) return 1;
 
-    pthread_mutex_lock(&dev->thread.lock);
-    dev->thread.work = 1;
-    pthread_cond_signal(&dev->thread.cond);
-    pthread_mutex_unlock(&dev->thread.lock);
-    return 0;
+    return post_job(&dev->thread, &job);
 }
 
 int prepare_thread(struct ocl_device* dev)
 {
     if (!dev->initialized) return 0;
 
-    dev->thread.work = 0;
-    if (pthread_mutex_init(&dev->thread.lock, NULL)) return 1;
-    if (pthread_cond_init(&dev->thread.cond, NULL)) return 1;
+    if (start_rings(&dev->thread)) return 1;
     pthread_create(&dev->thread.tid, NULL, ocl_kernel, dev);
     return 0;
 }
@@ -130,8 +117,11 @@ int main()
 
     for (i = 0; i < nr_devices; i++)
     {
+        struct ocl_completion c;
+
         if (signal_device(&ocl_devices[i])) return 1;
-        sleep(1);
+        take_completion(&ocl_devices[i].thread, &c);
+        ret += c.err;
     }
 
     printf("finishing test\n");
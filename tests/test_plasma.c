@@ -105,7 +105,7 @@ void set_point1(int x, int y, int w, int h, float c1, float c2, float c3, float
     // c4   n3    c3
     if (w < 2 && h < 2)
     {
-        pixels[x + y * WIDTH] = 0xff000000 | get_color((c1 + c2 + c3 + c4) / 4);
+        pixels[x + y * DEFAULT_WIDTH] = 0xff000000 | get_color((c1 + c2 + c3 + c4) / 4);
     }
     else
     {
@@ -118,7 +118,7 @@ void set_point1(int x, int y, int w, int h, float c1, float c2, float c3, float
         n3 = (c3 + c4) / 2.0;
         n4 = (c1 + c4) / 2.0;
 
-        d = ofs_mult * (w + h) / (WIDTH + HEIGHT);
+        d = ofs_mult * (w + h) / (DEFAULT_WIDTH + DEFAULT_HEIGHT);
 
         n5 = (c1 + c2 + c3 + c4) / 4.0;
         if (!call_offset[calls])
@@ -143,7 +143,7 @@ void set_point2(int x, int y, int w, int h, float c1, float c2, float c3, float
     // c4   n3    c3
     if (w < 2 && h < 2)
     {
-        pixels[x + y * WIDTH] = 0xff000000 | get_color((c1 + c2 + c3 + c4) / 4);
+        pixels[x + y * DEFAULT_WIDTH] = 0xff000000 | get_color((c1 + c2 + c3 + c4) / 4);
     }
     else
     {
@@ -152,7 +152,7 @@ void set_point2(int x, int y, int w, int h, float c1, float c2, float c3, float
         w /= 2;
         h /= 2;
 
-        d = ofs_mult * (w + h) / (WIDTH + HEIGHT);
+        d = ofs_mult * (w + h) / (DEFAULT_WIDTH + DEFAULT_HEIGHT);
         n5 = (c1 + c2 + c3 + c4) / 4.0 + get_ofs(d);
 
         n1 = (c1 + c2 + 2 * n5) / 4.0 + get_ofs(d);
@@ -189,12 +189,12 @@ int main()
     int sc;
     float ind = 0.0;
 
-    if (posix_memalign((void**)&pixels, 4096, IMAGE_SIZE)) return 1;
+    if (posix_memalign((void**)&pixels, 4096, (DEFAULT_WIDTH * DEFAULT_HEIGHT * BPP))) return 1;
 
     init_window();
 
-    window_rec.w = WIDTH;
-    window_rec.h = HEIGHT;
+    window_rec.w = DEFAULT_WIDTH;
+    window_rec.h = DEFAULT_HEIGHT;
     window_rec.x = 0;
     window_rec.y = 0;
 
@@ -216,11 +216,11 @@ int main()
             else
                 ind = 0.0;
 
-            for (y = 0; y < HEIGHT; y++)
+            for (y = 0; y < DEFAULT_HEIGHT; y++)
             {
-                for (x = 0; x < WIDTH; x++)
+                for (x = 0; x < DEFAULT_WIDTH; x++)
                 {
-                    pixels[x + y * WIDTH] = 0xff000000 | get_color(1.0 * (x + ind) / WIDTH);
+                    pixels[x + y * DEFAULT_WIDTH] = 0xff000000 | get_color(1.0 * (x + ind) / DEFAULT_WIDTH);
                 }
             }
         }
@@ -245,9 +245,9 @@ int main()
                         {
                             float r, g, b;
                             int rc, gc, bc;
-                            r = ((pixels[x + y * WIDTH] & 0xff0000) >> 16) / 255.0;
-                            g = ((pixels[x + y * WIDTH] & 0xff00) >> 8) / 255.0;
-                            b = (pixels[x + y * WIDTH] & 0xff) / 255.0;
+                            r = ((pixels[x + y * DEFAULT_WIDTH] & 0xff0000) >> 16) / 255.0;
+                            g = ((pixels[x + y * DEFAULT_WIDTH] & 0xff00) >> 8) / 255.0;
+                            b = (pixels[x + y * DEFAULT_WIDTH] & 0xff) / 255.0;
                             r += o;
                             g += o;
                             b += o;
@@ -257,7 +257,7 @@ int main()
                             gc &= 0xff;
                             bc = b * 255;
                             bc &= 0xff;
-                            pixels[x + y * WIDTH] = 0xff000000 | rc << 16 | gc << 8 | bc;
+                            pixels[x + y * DEFAULT_WIDTH] = 0xff000000 | rc << 16 | gc << 8 | bc;
                         }
                     }
                 }
@@ -399,15 +399,15 @@ int main()
             }
             if (event.type == SDL_MOUSEMOTION)
             {
-                if (event.button.x > WIDTH) continue;
+                if (event.button.x > DEFAULT_WIDTH) continue;
                 mx = event.button.x;
                 my = event.button.y;
-                sprintf(status_line, "[%3d,%3d]=%-8x %2d ", mx, my, pixels[my * WIDTH + mx] & 0xffffff, pixels[my * WIDTH + mx] & 0xff);
-                write_text(status_line, WIDTH, 0);
+                sprintf(status_line, "[%3d,%3d]=%-8x %2d ", mx, my, pixels[my * DEFAULT_WIDTH + mx] & 0xffffff, pixels[my * DEFAULT_WIDTH + mx] & 0xff);
+                write_text(status_line, DEFAULT_WIDTH, 0);
             }
         }
 
-        SDL_UpdateTexture(texture, NULL, pixels, WIDTH * 4);
+        SDL_UpdateTexture(texture, NULL, pixels, DEFAULT_WIDTH * 4);
         SDL_RenderCopy(main_window, texture, NULL, &window_rec);
         SDL_RenderPresent(main_window);
 
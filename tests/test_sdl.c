@@ -29,27 +29,27 @@ int main()
     unsigned long tp1, tp2;
     int fin = 0;
 
-    if (posix_memalign((void**)&pixels, 4096, IMAGE_SIZE)) return 1;
+    if (posix_memalign((void**)&pixels, 4096, (DEFAULT_WIDTH * DEFAULT_HEIGHT * BPP))) return 1;
 
     init_window();
 
-    for (y = 0; y < HEIGHT; y++)
+    for (y = 0; y < DEFAULT_HEIGHT; y++)
     {
-        for (x = 0; x < WIDTH; x++)
+        for (x = 0; x < DEFAULT_WIDTH; x++)
         {
-            r = 0x80 + 0x7f * sin(6.28 * x / WIDTH);
-            g = 0x80 + 0x7f * sin(6.28 * y / HEIGHT);
-            b = 0x80 + 0x7f * cos(6.28 * (x + y) / (WIDTH + HEIGHT));
+            r = 0x80 + 0x7f * sin(6.28 * x / DEFAULT_WIDTH);
+            g = 0x80 + 0x7f * sin(6.28 * y / DEFAULT_HEIGHT);
+            b = 0x80 + 0x7f * cos(6.28 * (x + y) / (DEFAULT_WIDTH + DEFAULT_HEIGHT));
 
-            pixels[y * WIDTH + x] = r << 16 | g << 8 | b;
+            pixels[y * DEFAULT_WIDTH + x] = r << 16 | g << 8 | b;
         }
     }
     int mx = 0, my = 0;
 
     SDL_Rect window_rec;
 
-    window_rec.w = WIDTH;
-    window_rec.h = HEIGHT;
+    window_rec.w = DEFAULT_WIDTH;
+    window_rec.h = DEFAULT_HEIGHT;
     window_rec.x = 0;
     window_rec.y = 0;
 
@@ -75,7 +75,7 @@ int main()
             }
             if (event.type == SDL_MOUSEMOTION)
             {
-                if (event.button.x > WIDTH) continue;
+                if (event.button.x > DEFAULT_WIDTH) continue;
                 mx = event.button.x;
                 my = event.button.y;
             }
@@ -84,20 +84,20 @@ int main()
         /*
                 for (y = 0 ; y < 20; y++)  {
                     for (x = 0 ; x < 20; x++) {
-                        unsigned int ofs = (my - 10 + y) * WIDTH + (mx - 10 + x);
-                        if (ofs > 0 && ofs < WIDTH *HEIGHT)
+                        unsigned int ofs = (my - 10 + y) * DEFAULT_WIDTH + (mx - 10 + x);
+                        if (ofs > 0 && ofs < DEFAULT_WIDTH *DEFAULT_HEIGHT)
                             pixels[ofs]++;
                     }
                 }
         */
-        SDL_UpdateTexture(texture, NULL, pixels, WIDTH * 4);
+        SDL_UpdateTexture(texture, NULL, pixels, DEFAULT_WIDTH * 4);
         //        SDL_RenderCopy(main_window, texture, NULL, NULL);
         SDL_RenderCopy(main_window, texture, NULL, &window_rec);
 
         avg = i ? render_times / i : 0;
         fps = avg ? 1000000 / avg : 0;
-        sprintf(status_line, "test SDL[%d,%d]=%x %d render time=%lu avg=%lu fps=%lu", mx, my, pixels[my * WIDTH + mx], i, render_time, avg, fps);
-        write_text(status_line, 0, HEIGHT / 2);
+        sprintf(status_line, "test SDL[%d,%d]=%x %d render time=%lu avg=%lu fps=%lu", mx, my, pixels[my * DEFAULT_WIDTH + mx], i, render_time, avg, fps);
+        write_text(status_line, 0, DEFAULT_HEIGHT / 2);
         SDL_RenderPresent(main_window);
         tp2 = get_time_usec();
         render_time = tp2 - tp1;
@@ -39,14 +39,14 @@ void draw_circle(int i)
 
     if (!x)
     {
-        x = random() % (WIDTH - SIZE);
+        x = random() % (DEFAULT_WIDTH - SIZE);
         dir_x = -1 - random() % 3;
         if (!dir_x) dir_x = 1;
         circles[i].color = random();
     }
     if (!y)
     {
-        y = random() % (HEIGHT - SIZE);
+        y = random() % (DEFAULT_HEIGHT - SIZE);
         dir_y = -1 - random() % 3;
         if (!dir_y) dir_y = -dir_x;
     }
@@ -55,9 +55,9 @@ void draw_circle(int i)
     x += dir_x;
     y += dir_y;
 
-    if (x > WIDTH - SIZE) dir_x *= -1;
+    if (x > DEFAULT_WIDTH - SIZE) dir_x *= -1;
     if (x < SIZE) dir_x *= -1;
-    if (y > HEIGHT - SIZE) dir_y *= -1;
+    if (y > DEFAULT_HEIGHT - SIZE) dir_y *= -1;
     if (y < SIZE) dir_y *= -1;
 
     circles[i].x = x;
@@ -77,7 +77,7 @@ int main()
 
     srandom(time(0));
 
-    if (posix_memalign((void**)&pixels, 4096, IMAGE_SIZE)) return 1;
+    if (posix_memalign((void**)&pixels, 4096, (DEFAULT_WIDTH * DEFAULT_HEIGHT * BPP))) return 1;
 
     init_window();
 
@@ -112,7 +112,7 @@ int main()
             }
             /*				if (event.type == SDL_MOUSEMOTION)
                             {
-                                if (event.button.x > WIDTH) continue;
+                                if (event.button.x > DEFAULT_WIDTH) continue;
                                 mx = event.button.x;
                                 my = event.button.y;
                             }*/
@@ -125,7 +125,7 @@ int main()
         avg = i ? render_times / i : 0;
         fps = avg ? 1000000 / avg : 0;
         sprintf(status_line, "test SDL: %d/%d render time=%lu avg=%lu fps=%lu/%3d ", i, ITERATIONS, render_time, avg, fps, SDL_getFramerate(&fps_manager));
-        write_text(status_line, 0, HEIGHT / 2);
+        write_text(status_line, 0, DEFAULT_HEIGHT / 2);
         SDL_RenderPresent(main_window);
         SDL_framerateDelay(&fps_manager);
 